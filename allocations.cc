@@ -0,0 +1,46 @@
+#include "allocations.h"
+
+#include <cassert>
+
+#ifndef NDEBUG
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local unsigned long allocated = 0;
+thread_local unsigned long exempted = 0;
+}  // namespace
+
+// Only the plain forms are replaced; the array forms call these.  There is
+// no exception to throw when built without them, so running out aborts.
+void* operator new(std::size_t size) {
+  ++allocated;
+  if (void* p = std::malloc(size ? size : 1)) return p;
+  std::abort();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+unsigned long Allocations::count() { return allocated - exempted; }
+
+Allocations::Exempt::Exempt() : start_(allocated) {}
+
+Allocations::Exempt::~Exempt() { exempted += allocated - start_; }
+
+#else
+
+unsigned long Allocations::count() { return 0; }
+
+Allocations::Exempt::Exempt() : start_(0) {}
+
+Allocations::Exempt::~Exempt() {}
+
+#endif
+
+Allocations::Check::Check(bool armed) : armed_(armed), start_(count()) {}
+
+Allocations::Check::~Check() {
+  assert(!armed_ || count() == start_);
+}
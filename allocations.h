@@ -0,0 +1,31 @@
+#pragma once
+
+// Counts the heap allocations made by the current thread, so that frames
+// can check they make none once warmed up.  Only debug builds count; in
+// release builds the count is always zero.
+class Allocations {
+ public:
+  static unsigned long count();
+
+  // Asserts that nothing was allocated while it was alive, if armed.
+  class Check {
+   public:
+    explicit Check(bool armed);
+    ~Check();
+
+   private:
+    bool armed_;
+    unsigned long start_;
+  };
+
+  // Allocations made while one of these is alive are not counted, for
+  // things like logs that are expected to grow.
+  class Exempt {
+   public:
+    Exempt();
+    ~Exempt();
+
+   private:
+    unsigned long start_;
+  };
+};
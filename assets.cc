@@ -0,0 +1,80 @@
+#include "assets.h"
+
+#include <fstream>
+
+namespace {
+
+// Reads the size of a PNG from its header without decoding it.
+size_t png_bytes(const std::string& path) {
+  unsigned char header[24];
+  std::ifstream reader(path, std::ios::binary);
+  if (!reader.read(reinterpret_cast<char*>(header), sizeof(header))) return 0;
+
+  auto be32 = [&header](int i) {
+    return static_cast<size_t>(header[i]) << 24 | header[i + 1] << 16 |
+           header[i + 2] << 8 | header[i + 3];
+  };
+  return be32(16) * be32(20) * 4;
+}
+
+}  // namespace
+
+Assets& Assets::get() {
+  static Assets assets;
+  return assets;
+}
+
+template <typename T, typename... Args>
+std::shared_ptr<const T> Assets::find_or_add(const std::string& key,
+                                             const std::string& file,
+                                             Args&&... args) {
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  auto it = assets_.find(key);
+  if (it == assets_.end()) {
+    std::shared_ptr<const T> asset =
+        std::make_shared<T>(std::forward<Args>(args)...);
+    it = assets_.emplace(key, Entry{asset, file}).first;
+    if (image_bytes_.count(file) == 0) {
+      image_bytes_[file] = png_bytes(kContentPath + file);
+    }
+  }
+  return std::static_pointer_cast<const T>(it->second.asset);
+}
+
+std::shared_ptr<const SpriteMap> Assets::sprite_map(const std::string& file,
+                                                    int cols, int width,
+                                                    int height) {
+  const std::string key = "spritemap:" + file + ":" + std::to_string(cols) +
+                          ":" + std::to_string(width) + "x" +
+                          std::to_string(height);
+  return find_or_add<SpriteMap>(key, file, file, cols, width, height);
+}
+
+std::shared_ptr<const Sprite> Assets::sprite(const std::string& file, int x,
+                                             int y, int width, int height) {
+  const std::string key = "sprite:" + file + ":" + std::to_string(x) + "," +
+                          std::to_string(y) + ":" + std::to_string(width) +
+                          "x" + std::to_string(height);
+  return find_or_add<Sprite>(key, file, file, x, y, width, height);
+}
+
+std::shared_ptr<const Backdrop> Assets::backdrop(const std::string& file) {
+  return find_or_add<Backdrop>("backdrop:" + file, file, file);
+}
+
+std::shared_ptr<const Text> Assets::text(const std::string& file) {
+  return find_or_add<Text>("text:" + file, file, file);
+}
+
+size_t Assets::count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return assets_.size();
+}
+
+size_t Assets::texture_bytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t total = 0;
+  for (const auto& image : image_bytes_) total += image.second;
+  return total;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "backdrop.h"
+#include "sprite.h"
+#include "spritemap.h"
+#include "text.h"
+
+// Sprite maps, sprites, backdrops and fonts shared by everything that uses
+// the same image, so that new screens and entities reuse what is already
+// loaded.  Assets stay resident for as long as the game runs, even when
+// nothing holds them, so changing screens never loads anything again.
+class Assets {
+ public:
+  static Assets& get();
+
+  std::shared_ptr<const SpriteMap> sprite_map(const std::string& file,
+                                              int cols, int width,
+                                              int height);
+  std::shared_ptr<const Sprite> sprite(const std::string& file, int x, int y,
+                                       int width, int height);
+  std::shared_ptr<const Backdrop> backdrop(const std::string& file);
+  std::shared_ptr<const Text> text(const std::string& file);
+
+  size_t count() const;
+  // Decoded size of every image in use, at four bytes a pixel.
+  size_t texture_bytes() const;
+
+ private:
+  static constexpr const char* kContentPath = "content/";
+
+  struct Entry {
+    std::shared_ptr<const void> asset;
+    std::string file;
+  };
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> assets_;
+  std::unordered_map<std::string, size_t> image_bytes_;
+
+  Assets() = default;
+
+  template <typename T, typename... Args>
+  std::shared_ptr<const T> find_or_add(const std::string& key,
+                                       const std::string& file,
+                                       Args&&... args);
+};
@@ -2,26 +2,43 @@
 
 #include <algorithm>
 #include <cassert>
-#include <fstream>
+#include <cstring>
 #include <map>
 #include <stack>
 #include <unordered_set>
 
+#include "allocations.h"
+#include "hash.h"
 #include "log.h"
-#include "ui.h"
-#include "util.h"
+#include "profiler.h"
+#include "room_templates.h"
 
-Dungeon::Dungeon(int width, int height, unsigned int seed)
+Dungeon::Dungeon(int width, int height, unsigned int seed, Mode mode,
+                 bool checked)
     : width_(width),
       height_(height),
+      origin_x_(width / 2 - 7),
+      origin_y_(height - 9),
+      seed_(seed),
+      mode_(mode),
+      checked_(checked),
+      attempts_(1),
+      newest_(0),
+      revision_(0),
+      layout_revision_(0),
       rng_(seed),
-      tiles_("tiles.png", 4, Config::kTileSize, Config::kTileSize),
-      ui_("ui.png", 10, Config::kHalfTile, Config::kHalfTile),
-      doors_("doors.png", 8, Config::kTileSize, Config::kTileSize),
-      wall_overlay_("room-overlay.png", 0, 0, 256, 176) {
-  load_room_data("content/rooms.txt");
-  while (!generate(seed)) {
-    ++seed;
+      layout_(std::make_shared<Layout>()),
+      blocks_(),
+      rooms_(),
+      journal_() {
+  if (mode_ == Mode::Endless) {
+    generate_endless(seed_);
+    return;
+  }
+
+  while (!generate(seed_)) {
+    ++seed_;
+    ++attempts_;
   }
 }
 
@@ -29,43 +46,43 @@ bool Dungeon::generate(unsigned int seed) {
   DEBUG_LOG << "Generating dungeon with seed " << seed << "\n";
   rng_.seed(seed);
 
-  for (int y = 0; y < height_; ++y) {
-    for (int x = 0; x < width_; ++x) {
-      cells_[y][x] = {Dungeon::Tile::Wall, 0, 0, false};
-    }
-  }
+  layout_ = std::make_shared<Layout>();
+  blocks_.clear();
 
-  int rx = width_ / 2 - 7;
-  int ry = height_ - 9;
+  int rx = origin_x_;
+  int ry = origin_y_;
   int room = 0;
 
-  place_room(rx, ry, room, RoomType::Entrance);
+  place_room(rx, ry, room, room, RoomType::Entrance);
   set_tile(rx + 6, ry + 8, Tile::DoorOpen);
+  add_door(rx + 6, ry + 8, room, -1);
 
   std::uniform_int_distribution<int> rand_dir(0, 3);
 
-  for (int i = 0; i < 15; ++i) {
+  for (int i = 0; i < kClassicRooms; ++i) {
     const Tile door_tile = room > 0 ? Tile::DoorLocked : Tile::DoorOpen;
     int tries = 10;
     while (tries > 0) {
       const int dir = rand_dir(rng_);
       if (dir == 0) {
-        if (try_place_door(rx + 6, ry, rx + 6, ry - 1, door_tile)) {
+        if (try_place_door(rx + 6, ry, rx + 6, ry - 1, room, door_tile)) {
           ry -= 8;
           break;
         }
       } else if (dir == 1) {
-        if (try_place_door(rx + 6, ry + 8, rx + 6, ry + 1, door_tile)) {
+        if (try_place_door(rx + 6, ry + 8, rx + 6, ry + 1, room,
+                           door_tile)) {
           ry += 8;
           break;
         }
       } else if (dir == 2) {
-        if (try_place_door(rx + 12, ry + 4, rx + 13, ry + 4, door_tile)) {
+        if (try_place_door(rx + 12, ry + 4, rx + 13, ry + 4, room,
+                           door_tile)) {
           rx += 12;
           break;
         }
       } else if (dir == 3) {
-        if (try_place_door(rx, ry + 4, rx - 1, ry + 4, door_tile)) {
+        if (try_place_door(rx, ry + 4, rx - 1, ry + 4, room, door_tile)) {
           rx -= 12;
           break;
         }
@@ -75,44 +92,157 @@ bool Dungeon::generate(unsigned int seed) {
         return false;
       }
     }
-    place_room(rx, ry, ++room, RoomType::Normal);
+    ++room;
+    place_room(rx, ry, room, room, RoomType::Normal);
+    if (checked_ && !solvable(room)) return false;
   }
 
   DEBUG_LOG << "Done placing rooms.\n";
   return true;
 }
 
+void Dungeon::generate_endless(unsigned int seed) {
+  DEBUG_LOG << "Starting endless dungeon with seed " << seed << "\n";
+  rng_.seed(seed);
+  layout_ = std::make_shared<Layout>();
+  blocks_.clear();
+
+  place_room(origin_x_, origin_y_, 0, 0, RoomType::Entrance);
+  set_tile(origin_x_ + 6, origin_y_ + 8, Tile::DoorOpen);
+  add_door(origin_x_ + 6, origin_y_ + 8, 0, -1);
+  newest_ = 0;
+  extend(Tile::DoorOpen);
+}
+
+void Dungeon::extend(Tile door_tile) {
+  // Rooms are made in the middle of play, once a room, and making one
+  // allocates its block and its share of the layout.
+  Allocations::Exempt exempt;
+  const int from = newest_;
+  const int number = rooms_[from].number + 1;
+  const int room = number % kRoomCount;
+  if (number >= kEndlessRooms) evict((number - kEndlessRooms) % kRoomCount);
+
+  // Each way out: where the door goes on the wall and where the next room
+  // would be, in rooms.
+  static constexpr struct {
+    int door_x, door_y, dx, dy;
+  } kExits[] = {{6, 0, 0, -1}, {6, 8, 0, 1}, {12, 4, 1, 0}, {0, 4, -1, 0}};
+
+  const Position o = layout_->rooms[from].origin;
+  const int first = random_in_range(0, 3);
+  for (int i = 0; i < 4; ++i) {
+    const auto& exit = kExits[(first + i) % 4];
+    const int x = o.x + exit.dx * kBlockWidth;
+    const int y = o.y + exit.dy * kBlockHeight;
+    if (!room_fits(x, y)) continue;
+
+    DEBUG_LOG << "Extending to room " << number << "\n";
+    // Checked rooms are made again until they can be solved, as the rooms
+    // before them can no longer be.
+    while (true) {
+      place_room(x, y, room, number, RoomType::Normal);
+      if (!checked_ || solvable(room)) break;
+      drop_block(x, y);
+      layout().rooms[room] = {};
+    }
+
+    newest_ = room;
+    set_tile(o.x + exit.door_x, o.y + exit.door_y, door_tile);
+    add_door(o.x + exit.door_x, o.y + exit.door_y, from, room);
+    return;
+  }
+
+  // With only the room before it kept, there is always a way out of the
+  // newest room unless the dungeon is too small to hold three rooms.
+  assert(false && "no space for the next room");
+}
+
+bool Dungeon::room_fits(int x, int y) const {
+  if (x < 0 || x + kBlockWidth >= width_) return false;
+  if (y < 0 || y + kBlockHeight >= height_) return false;
+  return find_block(x + 1, y + 1) == nullptr;
+}
+
+void Dungeon::evict(int room) {
+  DEBUG_LOG << "Forgetting room " << rooms_[room].number << "\n";
+
+  // Walls go up in every doorway first.  Doors on the south and east walls
+  // are in the next room over, and anything left with no doors goes.
+  Layout& l = layout();
+  for (size_t d : l.rooms[room].doors) {
+    const auto p = l.doors[d].position;
+    set_tile(p.x, p.y, Tile::Wall);
+    const Block* b = find_block(p.x, p.y);
+    if (b && std::all_of(b->tiles.begin(), b->tiles.end(),
+                         [](Tile t) { return t == Tile::Wall; })) {
+      drop_block(p.x, p.y);
+    }
+  }
+
+  const Position o = l.rooms[room].origin;
+  drop_block(o.x + 1, o.y + 1);
+  ++revision_;
+  ++layout_revision_;
+
+  l.doors.erase(std::remove_if(l.doors.begin(), l.doors.end(),
+                               [room](const Door& door) {
+                                 return door.from == room || door.to == room;
+                               }),
+                l.doors.end());
+  l.rooms[room] = {};
+  rooms_[room] = {};
+
+  for (auto& r : l.rooms) r.doors.clear();
+  for (size_t d = 0; d < l.doors.size(); ++d) {
+    l.rooms[l.doors[d].from].doors.push_back(d);
+    if (l.doors[d].to >= 0) l.rooms[l.doors[d].to].doors.push_back(d);
+  }
+}
+
 void Dungeon::apply_template(int x, int y, int n) {
   DEBUG_LOG << "Applying template " << n << "\n";
   for (int ty = 0; ty < 7; ++ty) {
     for (int tx = 0; tx < 11; ++tx) {
-      set_tile(x + tx + 1, y + ty + 1, room_templates_[n][ty * 11 + tx]);
+      set_tile(x + tx + 1, y + ty + 1, RoomTemplates::get(n)[ty * 11 + tx]);
     }
   }
 }
 
-void Dungeon::tile_room(int x, int y, RoomType type) {
+int Dungeon::tile_room(int x, int y, RoomType type) {
+  int n = -1;
   if (type == RoomType::Entrance) {
-    apply_template(x, y, 0);
+    n = 0;
   } else if (type == RoomType::Normal) {
     std::uniform_int_distribution<int> rand_template(
-        1, room_templates_.size() - 1);
-    apply_template(x, y, rand_template(rng_));
+        1, RoomTemplates::count() - 1);
+    n = rand_template(rng_);
   }
+  if (n >= 0) apply_template(x, y, n);
+  return n;
 }
 
 Dungeon::Position Dungeon::grid_coords(double px, double py) const {
-  return {(int)(px / Config::kTileSize), (int)(py / Config::kTileSize)};
+  return {(int)(px / kTileSize), (int)(py / kTileSize)};
 }
 
 Dungeon::Position Dungeon::find_tile(Tile tile) const {
-  for (int y = 0; y < height_; ++y) {
-    for (int x = 0; x < width_; ++x) {
-      if (cells_[y][x].tile == tile) return {x, y};
+  Position found = {-1, -1};
+  for (const auto& b : blocks_) {
+    if (!b) continue;
+    const Block& block = *b;
+    const auto* t = static_cast<const Tile*>(
+        std::memchr(block.tiles.data(), static_cast<int>(tile), kBlockSize));
+    if (!t) continue;
+
+    const int i = t - block.tiles.data();
+    const Position p = {block.x + i % kBlockWidth, block.y + i / kBlockWidth};
+    if (found.y < 0 || p.y < found.y || (p.y == found.y && p.x < found.x)) {
+      found = p;
     }
   }
 
-  return {-1, -1};
+  return found;
 }
 
 bool Dungeon::Cell::is_door() const {
@@ -126,133 +256,98 @@ bool Dungeon::Cell::is_door() const {
   }
 }
 
-void Dungeon::draw(Graphics& graphics, int hud_height, int xo, int yo) const {
-  door_tiles_[0] = Tile::Wall;
-  door_tiles_[1] = Tile::Wall;
-  door_tiles_[2] = Tile::Wall;
-  door_tiles_[3] = Tile::Wall;
-
-  for (int y = 0; y < height_; ++y) {
-    const int gy = Config::kTileSize * y - yo;
-    if (gy < hud_height - Config::kTileSize) continue;
-    if (gy > graphics.height()) break;
-
-    for (int x = 0; x < width_; ++x) {
-      const int gx = Config::kTileSize * x - xo;
-      if (gx < -Config::kTileSize) continue;
-      if (gx > graphics.width()) break;
-
-      auto cell = cells_[y][x];
-      if (cell.is_door()) {
-        if (gy == 96) {
-          doors_.draw(graphics, 32, gx, gy);
-          door_tiles_[0] = cell.tile;
-        } else if (gy == 224) {
-          doors_.draw(graphics, 40, gx, gy);
-          door_tiles_[1] = cell.tile;
-        } else if (gx == 24) {
-          doors_.draw(graphics, 48, gx, gy);
-          door_tiles_[2] = cell.tile;
-        } else if (gx == 216) {
-          doors_.draw(graphics, 56, gx, gy);
-          door_tiles_[3] = cell.tile;
-        }
-      } else if (cell.tile == Tile::Wall) {
-        if (gy == 96) doors_.draw(graphics, 27, gx, gy);
-        if (gy == 224) doors_.draw(graphics, 28, gx, gy);
-        if (gx == 24) doors_.draw(graphics, 29, gx, gy);
-        if (gx == 216) doors_.draw(graphics, 30, gx, gy);
-      } else {
-        tiles_.draw(graphics, static_cast<int>(cell.tile), gx, gy);
-        if (cell.value > 0) {
-          const int vx = cell.value > 9 ? gx : gx + Config::kQuarterTile;
-          const int vy = gy + Config::kQuarterTile;
-          const UI::Color vc = cell.active ? UI::Color::Cyan : UI::Color::Black;
-          UI::draw_small_number(graphics, ui_, vx, vy, cell.value, vc);
-        }
-      }
-    }
-  }
-}
-
-#define DRAW_DOOR_TILE(n, ox, oy)                          \
-  doors_.draw(graphics, (n), x + (ox) * Config::kTileSize, \
-              y + (oy) * Config::kTileSize)
-
-void Dungeon::draw_door_frame(Graphics& graphics, Tile tile, int x,
-                              int y) const {
-  if (tile == Tile::Wall) return;
-
-  if (y == 96) {  // north door
-    DRAW_DOOR_TILE(0, -1, -1);
-    DRAW_DOOR_TILE(1, 0, -1);
-    DRAW_DOOR_TILE(2, 1, -1);
-    DRAW_DOOR_TILE(8, -1, 0);
-    if (tile == Tile::DoorLocked) DRAW_DOOR_TILE(33, 0, 0);
-    if (tile == Tile::DoorClosed) DRAW_DOOR_TILE(36, 0, 0);
-    DRAW_DOOR_TILE(10, 1, 0);
-  } else if (y == 224) {  // south door
-    DRAW_DOOR_TILE(16, -1, 0);
-    if (tile == Tile::DoorLocked) DRAW_DOOR_TILE(41, 0, 0);
-    if (tile == Tile::DoorClosed) DRAW_DOOR_TILE(44, 0, 0);
-    DRAW_DOOR_TILE(18, 1, 0);
-    DRAW_DOOR_TILE(24, -1, 1);
-    DRAW_DOOR_TILE(25, 0, 1);
-    DRAW_DOOR_TILE(26, 1, 1);
-  } else if (x == 24) {  // west door
-    DRAW_DOOR_TILE(3, -1, -1);
-    DRAW_DOOR_TILE(4, 0, -1);
-    DRAW_DOOR_TILE(11, -1, 0);
-    if (tile == Tile::DoorLocked) DRAW_DOOR_TILE(49, 0, 0);
-    if (tile == Tile::DoorClosed) DRAW_DOOR_TILE(52, 0, 0);
-    DRAW_DOOR_TILE(19, -1, 1);
-    DRAW_DOOR_TILE(20, 0, 1);
-  } else if (x == 216) {  // east door
-    DRAW_DOOR_TILE(5, 0, -1);
-    DRAW_DOOR_TILE(6, 1, -1);
-    if (tile == Tile::DoorLocked) DRAW_DOOR_TILE(57, 0, 0);
-    if (tile == Tile::DoorClosed) DRAW_DOOR_TILE(60, 0, 0);
-    DRAW_DOOR_TILE(14, 1, 0);
-    DRAW_DOOR_TILE(21, 0, 1);
-    DRAW_DOOR_TILE(22, 1, 1);
-  }
-}
-
-void Dungeon::draw_overlay(Graphics& graphics, int hud_height) const {
-  wall_overlay_.draw(graphics, 0, hud_height);
-  draw_door_frame(graphics, door_tiles_[0], 120, 96);
-  draw_door_frame(graphics, door_tiles_[1], 120, 224);
-  draw_door_frame(graphics, door_tiles_[2], 24, 160);
-  draw_door_frame(graphics, door_tiles_[3], 216, 160);
-}
-
 bool Dungeon::walkable(int x, int y) const {
-  switch (get_cell(x, y).tile) {
-    case Dungeon::Tile::Room:
-    case Dungeon::Tile::DoorOpen:
-    case Dungeon::Tile::Sand:
-      return true;
-    default:
-      return false;
-  }
+  if (x < 0 || x >= width_) return false;
+  if (y < 0 || y >= height_) return false;
+
+  const Block* b = find_block(x, y);
+  return b && b->walkable_bit(b->index(x, y));
 }
 
 void Dungeon::set_tile(int x, int y, Dungeon::Tile tile) {
   if (x < 0 || x >= width_) return;
   if (y < 0 || y >= height_) return;
-  cells_[y][x].tile = tile;
+  Block& b = block(x, y);
+  const int i = b.index(x, y);
+  const std::uint64_t walkable = b.walkable_bit(i);
+  b.set(i, tile);
+  ++revision_;
+  if (b.walkable_bit(i) != walkable) ++layout_revision_;
 }
 
-Dungeon::Tile Dungeon::get_tile(int x, int y) {
-  if (x < 0 || x >= width_) return Tile::OutOfBounds;
-  if (y < 0 || y >= height_) return Tile::OutOfBounds;
-  return cells_[y][x].tile;
-}
+Dungeon::Tile Dungeon::get_tile(int x, int y) { return get_cell(x, y).tile; }
 
-const Dungeon::Cell& Dungeon::get_cell(int x, int y) const {
+Dungeon::Cell Dungeon::get_cell(int x, int y) const {
   if (x < 0 || x >= width_) return kBadCell;
   if (y < 0 || y >= height_) return kBadCell;
-  return cells_[y][x];
+
+  const Block* b = find_block(x, y);
+  return b ? b->cell(b->index(x, y)) : kWallCell;
+}
+
+namespace {
+int floor_div(int a, int b) { return a / b - (a % b < 0 ? 1 : 0); }
+}  // namespace
+
+int Dungeon::block_key(int x, int y) const {
+  const int bx = floor_div(x - origin_x_, kBlockWidth);
+  const int by = floor_div(y - origin_y_, kBlockHeight);
+  return by * 0x10000 + bx;
+}
+
+Dungeon::Layout& Dungeon::layout() {
+  if (layout_.use_count() > 1) layout_ = std::make_shared<Layout>(*layout_);
+  return *layout_;
+}
+
+int Dungeon::block_slot(int x, int y) const {
+  const auto slot = layout_->blocks.find(block_key(x, y));
+  return slot == layout_->blocks.end() ? -1 : slot->second;
+}
+
+const Dungeon::Block* Dungeon::find_block(int x, int y) const {
+  const int slot = block_slot(x, y);
+  return slot < 0 ? nullptr : blocks_[slot].get();
+}
+
+Dungeon::Block* Dungeon::find_block(int x, int y) {
+  const int slot = block_slot(x, y);
+  return slot < 0 ? nullptr : &unshare_block(slot);
+}
+
+Dungeon::Block& Dungeon::unshare_block(int slot) {
+  auto& b = blocks_[slot];
+  if (b.use_count() > 1) b = std::make_shared<Block>(*b);
+  return *b;
+}
+
+Dungeon::Block& Dungeon::block(int x, int y) {
+  Block* existing = find_block(x, y);
+  if (existing) return *existing;
+
+  const auto empty = std::find(blocks_.begin(), blocks_.end(), nullptr);
+  const int slot = empty - blocks_.begin();
+  if (empty == blocks_.end()) blocks_.emplace_back();
+  blocks_[slot] = std::make_shared<Block>();
+  layout().blocks[block_key(x, y)] = slot;
+
+  Block& b = *blocks_[slot];
+  b.x = origin_x_ + floor_div(x - origin_x_, kBlockWidth) * kBlockWidth;
+  b.y = origin_y_ + floor_div(y - origin_y_, kBlockHeight) * kBlockHeight;
+  b.tiles.fill(kWallCell.tile);
+  b.rooms.fill(kWallCell.room);
+  b.values.fill(kWallCell.value);
+  b.active.fill(kWallCell.active);
+  b.walkable.fill(0);
+  return b;
+}
+
+void Dungeon::drop_block(int x, int y) {
+  Layout& l = layout();
+  const auto slot = l.blocks.find(block_key(x, y));
+  if (slot == l.blocks.end()) return;
+  blocks_[slot->second].reset();
+  l.blocks.erase(slot);
 }
 
 namespace {
@@ -261,33 +356,42 @@ int lerp(int a, int b, float t) {
 }
 }  // namespace
 
-void Dungeon::place_room(int x, int y, int room, RoomType type) {
+void Dungeon::place_room(int x, int y, int room, int number,
+                         RoomType type) {
   DEBUG_LOG << "Placing room at " << x << ", " << y << "\n";
   for (int ty = 0; ty < 7; ++ty) {
     for (int tx = 0; tx < 11; ++tx) {
-      Cell& cell = cells_[ty + y + 1][tx + x + 1];
-      cell.tile = Tile::Room;
-      cell.room = room;
+      Block& b = block(tx + x + 1, ty + y + 1);
+      const int i = b.index(tx + x + 1, ty + y + 1);
+      b.set(i, Tile::Room);
+      b.rooms[i] = room;
     }
   }
-  tile_room(x, y, type);
+  ++layout_revision_;
+  layout().rooms[room].origin = {x, y};
+  const int n = tile_room(x, y, type);
+  layout().rooms[room].room_template = n;
   if (type != RoomType::Normal) return;
 
   DEBUG_LOG << "Configuring room\n";
 
-  float t = (room - 1) / 14.f;
-  const int min_target = lerp(10, 100, t);
-  const int max_target = lerp(25, 300, t);
+  float t = (number - 1) / float(kClassicRooms - 1);
+  const int min_target = std::min(lerp(10, 100, t), kMaxTarget);
+  const int max_target = std::min(lerp(25, 300, t), kMaxTarget);
   const int target =
       std::uniform_int_distribution<int>(min_target, max_target)(rng_);
-  rooms_[room].number = room;
+  rooms_[room].number = number;
   rooms_[room].target = target;
 
-  const int rows = 3 + (room - 1) / 6;
-  const int cols = 3 + (room + 2) / 6;
+  const int rows = std::min(3 + (number - 1) / 6, kMaxValueRows);
+  const int cols = std::min(3 + (number + 2) / 6, kMaxValueRows);
   int tiles_to_value = rows * cols;
 
   const int max_group_size = std::min(rows + 1, cols + 1);
+  // Kept as they are placed for checking the room, rather than looking each
+  // of them up again.
+  std::array<int, kMaxValueRows * kMaxValueRows> placed;
+  int count = 0;
 
   while (tiles_to_value > 2) {
     const int tiles = std::min(tiles_to_value - 1, max_group_size);
@@ -297,20 +401,28 @@ void Dungeon::place_room(int x, int y, int room, RoomType type) {
     DEBUG_LOG << "  Set ";
     for (auto value : values) {
       DEBUG_LOG << value << ", ";
-      place_room_value(x, y, value);
+      const Position p = place_room_value(x, y, value);
+      layout().rooms[room].values.push_back(p);
+      placed[count++] = value;
     }
     DEBUG_LOG << "\n";
     tiles_to_value -= values.size();
   }
   while (tiles_to_value > 0) {
     int value = random_in_range(target / 4, 3 * target / 4);
-    place_room_value(x, y, std::min(value, 99));
+    const Position p = place_room_value(x, y, std::min(value, 99));
+    layout().rooms[room].values.push_back(p);
+    placed[count++] = std::min(value, 99);
     DEBUG_LOG << "  Extra " << value << "\n";
     --tiles_to_value;
   }
+
+  const bool reachable = SubsetSum::reachable(placed.data(), count, target);
+  layout().rooms[room].solvable = reachable;
+  if (!reachable) DEBUG_LOG << "Room " << room << " has no solution.\n";
 }
 
-void Dungeon::place_room_value(int x, int y, int value) {
+Dungeon::Position Dungeon::place_room_value(int x, int y, int value) {
   assert(value < 100);
 
   std::uniform_int_distribution<int> rx(x + 2, x + 10);
@@ -319,10 +431,11 @@ void Dungeon::place_room_value(int x, int y, int value) {
   while (true) {
     const int tx = rx(rng_);
     const int ty = ry(rng_);
-    auto& cell = cells_[ty][tx];
-    if (cell.value == 0 && cell.tile == Tile::Room) {
-      cell.value = value;
-      return;
+    Block& b = block(tx, ty);
+    const int i = b.index(tx, ty);
+    if (b.values[i] == 0 && b.tiles[i] == Tile::Room) {
+      b.values[i] = value;
+      return {tx, ty};
     }
   }
 }
@@ -359,27 +472,99 @@ std::vector<int> Dungeon::divide(int value, size_t max_count) {
   return results;
 }
 
-bool Dungeon::try_place_door(int x, int y, int cx, int cy, Tile door_tile) {
+bool Dungeon::try_place_door(int x, int y, int cx, int cy, int room,
+                             Tile door_tile) {
   if (get_tile(cx, cy) == Tile::Wall) {
     set_tile(x, y, door_tile);
+    add_door(x, y, room, room + 1);
     return true;
   }
   return false;
 }
 
-bool Dungeon::box_walkable(const Rect& r) const {
+void Dungeon::add_door(int x, int y, int from, int to) {
+  Layout& l = layout();
+  l.rooms[from].doors.push_back(l.doors.size());
+  if (to >= 0) l.rooms[to].doors.push_back(l.doors.size());
+  l.doors.push_back({{x, y}, from, to});
+}
+
+bool Dungeon::box_walkable(const Box& r) const {
+  const Block* near = nullptr;
+  return box_walkable(r, near);
+}
+
+void Dungeon::box_walkable(const Box* boxes, int count, bool* walkable) const {
+  const Block* near = nullptr;
+  for (int i = 0; i < count; ++i) walkable[i] = box_walkable(boxes[i], near);
+}
+
+// Near is the block the last box started in, which is usually the block the
+// next one starts in too.
+bool Dungeon::box_walkable(const Box& r, const Block*& near) const {
   const auto a = grid_coords(r.left, r.top);
   const auto b = grid_coords(r.right, r.bottom);
+  if (a.x < 0 || a.y < 0 || b.x >= width_ || b.y >= height_) return false;
+
+  if (!near || !near->contains(a.x, a.y)) near = find_block(a.x, a.y);
+  // Cells outside of every block are solid wall.
+  if (!near) return false;
+
+  // Boxes are smaller than rooms, so they are almost always inside the one
+  // block and the test is just the four corner bits.
+  if (near->contains(b.x, b.y)) {
+    return near->walkable_bit(near->index(a.x, a.y)) &
+           near->walkable_bit(near->index(a.x, b.y)) &
+           near->walkable_bit(near->index(b.x, a.y)) &
+           near->walkable_bit(near->index(b.x, b.y));
+  }
 
   return walkable(a.x, a.y) && walkable(a.x, b.y) && walkable(b.x, a.y) &&
          walkable(b.x, b.y);
 }
 
+double Dungeon::sweep_x(const Box& r, double dx) const {
+  const auto a = grid_coords(r.left, r.top);
+  const auto b = grid_coords(r.right, r.bottom);
+  return sweep(dx > 0 ? r.right : r.left, dx, a.y, b.y, true);
+}
+
+double Dungeon::sweep_y(const Box& r, double dy) const {
+  const auto a = grid_coords(r.left, r.top);
+  const auto b = grid_coords(r.right, r.bottom);
+  return sweep(dy > 0 ? r.bottom : r.top, dy, a.x, b.x, false);
+}
+
+// Moves the leading edge of a box one line of cells at a time, where each
+// line is the cells from low to high across the direction of movement.
+double Dungeon::sweep(double edge, double delta, int low, int high,
+                      bool horizontal) const {
+  if (delta == 0) return 0;
+
+  const int step = delta > 0 ? 1 : -1;
+  const int from = static_cast<int>(edge / kTileSize);
+  const int to = static_cast<int>((edge + delta) / kTileSize);
+  for (int line = from + step; line != to + step; line += step) {
+    for (int i = low; i <= high; ++i) {
+      if (horizontal ? walkable(line, i) : walkable(i, line)) continue;
+
+      // Box edges are the last pixel they cover, so the box stops with its
+      // edge on the pixel next to the cell.  It never moves back, even if
+      // it was already closer than that.
+      if (delta > 0) return std::max(0.0, line * kTileSize - 1 - edge);
+      return std::min(0.0, (line + 1) * kTileSize - edge);
+    }
+  }
+
+  return delta;
+}
+
 void Dungeon::open_door(int x, int y) {
   switch (get_cell(x, y).tile) {
     case Tile::DoorLocked:
     case Tile::DoorClosed:
-      cells_[y][x].tile = Tile::DoorOpen;
+      set_tile(x, y, Tile::DoorOpen);
+      record(Change::Kind::OpenDoor, x, y);
       break;
     default:
       // do nothing
@@ -388,47 +573,52 @@ void Dungeon::open_door(int x, int y) {
 }
 
 void Dungeon::clear_active_cells(int room) {
-  for (int y = 0; y < height_; ++y) {
-    for (int x = 0; x < width_; ++x) {
-      auto& cell = cells_[y][x];
-      if (cell.room == room && cell.active) {
-        DEBUG_LOG << "Clearing cell " << x << ", " << y << "\n";
-        cell.active = false;
-        cell.value = 0;
-      }
+  for (const auto& p : layout_->rooms[room].values) {
+    Block& b = block(p.x, p.y);
+    const int i = b.index(p.x, p.y);
+    if (b.active[i]) {
+      DEBUG_LOG << "Clearing cell " << p.x << ", " << p.y << "\n";
+      b.active[i] = false;
+      b.values[i] = 0;
+      ++revision_;
     }
   }
 }
 
 void Dungeon::unlock_doors(int room) {
-  for (int y = 0; y < height_; ++y) {
-    for (int x = 0; x < width_; ++x) {
-      auto& cell = cells_[y][x];
-      if (cell.tile == Tile::DoorLocked) {
-        if (get_cell(x - 1, y).room == room) cell.tile = Tile::DoorClosed;
-        if (get_cell(x + 1, y).room == room) cell.tile = Tile::DoorClosed;
-        if (get_cell(x, y - 1).room == room) cell.tile = Tile::DoorClosed;
-        if (get_cell(x, y + 1).room == room) cell.tile = Tile::DoorClosed;
-      }
+  for (size_t d : layout_->rooms[room].doors) {
+    const auto& p = layout_->doors[d].position;
+    if (get_tile(p.x, p.y) == Tile::DoorLocked) {
+      set_tile(p.x, p.y, Tile::DoorClosed);
     }
   }
 }
 
-Dungeon::Result Dungeon::activate(int x, int y, Audio& audio) {
+Dungeon::Result Dungeon::activate(int x, int y) {
+  PROFILE_ZONE("Dungeon::activate");
   if (x < 0 || x >= width_) return Result::None;
   if (y < 0 || y >= height_) return Result::None;
-  auto& cell = cells_[y][x];
-  if (cell.value == 0 || cell.active) return Result::None;
-  auto& room = get_room(x, y);
-  cell.active = true;
-  room.add(cell.value);
-  audio.play_sample("activate.wav");
+  const int s = block_slot(x, y);
+  if (s < 0) return Result::None;
+  // Checked before unsharing, so that copies of the dungeon only copy the
+  // block if something changes.
+  const int i = blocks_[s]->index(x, y);
+  if (blocks_[s]->values[i] == 0 || blocks_[s]->active[i]) {
+    return Result::None;
+  }
+  Block& b = unshare_block(s);
+  const int slot = b.rooms[i];
+  auto& room = rooms_[slot];
+  b.active[i] = true;
+  ++revision_;
+  record(Change::Kind::Activate, x, y);
+  room.add(b.values[i]);
   DEBUG_LOG << "Activated tile!  Room is now " << room.running_total << " of "
             << room.target << "\n";
   if (room.done()) {
     DEBUG_LOG << "Clearing active cells."
               << "\n";
-    clear_active_cells(room.number);
+    clear_active_cells(slot);
     if (room.overloaded()) {
       DEBUG_LOG << "Room overloaded, OUCH!"
                 << "\n";
@@ -437,12 +627,81 @@ Dungeon::Result Dungeon::activate(int x, int y, Audio& audio) {
     }
     DEBUG_LOG << "ORB"
               << "\n";
-    audio.play_sample("orb.wav");
-    unlock_doors(room.number);
+    unlock_doors(slot);
     room.clear();
+    if (mode_ == Mode::Endless && slot == newest_) extend(Tile::DoorClosed);
     return Result::Perfect;
   }
-  return Result::None;
+  return Result::Activated;
+}
+
+std::vector<Dungeon::Change> Dungeon::journal() const {
+  std::vector<Change> changes;
+  journal_.changes(changes);
+  return changes;
+}
+
+void Dungeon::journal(std::vector<Change>& changes) const {
+  journal_.changes(changes);
+}
+
+void Dungeon::replay(const std::vector<Change>& journal) {
+  for (const auto& change : journal) {
+    const auto p = change.position;
+    switch (change.kind) {
+      case Change::Kind::Activate:
+        activate(p.x, p.y);
+        break;
+      case Change::Kind::OpenDoor:
+        open_door(p.x, p.y);
+        break;
+    }
+  }
+}
+
+void Dungeon::record(Change::Kind kind, int x, int y) {
+  // The journal grows for as long as the run goes on.
+  Allocations::Exempt exempt;
+  journal_.add({kind, {x, y}});
+}
+
+Dungeon::Journal& Dungeon::Journal::operator=(Journal other) {
+  release();
+  head_ = std::move(other.head_);
+  size_ = other.size_;
+  return *this;
+}
+
+void Dungeon::Journal::add(Change change) {
+  if (!head_ || head_.use_count() > 1 || head_->count == kChunkSize) {
+    auto chunk = std::make_shared<Chunk>();
+    chunk->count = 0;
+    chunk->previous = std::move(head_);
+    head_ = std::move(chunk);
+  }
+  head_->changes[head_->count++] = change;
+  ++size_;
+}
+
+void Dungeon::Journal::changes(std::vector<Change>& changes) const {
+  changes.resize(size_);
+  auto end = changes.end();
+  for (const Chunk* c = head_.get(); c; c = c->previous.get()) {
+    end = std::copy_backward(c->changes.begin(),
+                             c->changes.begin() + c->count, end);
+  }
+}
+
+// Letting go of the last chunk of a long journal would free the one before
+// it from inside its destructor, and so on down the list, so chunks that
+// nothing else holds are freed one at a time instead.
+void Dungeon::Journal::release() {
+  std::shared_ptr<const Chunk> chunk = std::move(head_);
+  while (chunk && chunk.use_count() == 1) {
+    std::shared_ptr<const Chunk> previous = chunk->previous;
+    chunk = std::move(previous);
+  }
+  size_ = 0;
 }
 
 Dungeon::Room& Dungeon::get_room(int x, int y) {
@@ -453,40 +712,61 @@ const Dungeon::Room& Dungeon::get_room(int x, int y) const {
   return rooms_[get_cell(x, y).room];
 }
 
-namespace {
-Dungeon::Tile tile_for_char(char c) {
-  switch (c) {
-    case 'x':
-      return Dungeon::Tile::Block;
-    case 'o':
-      return Dungeon::Tile::Pit;
-    case 's':
-      return Dungeon::Tile::Sand;
-    case 'l':
-      return Dungeon::Tile::StatueLeft;
-    case 'r':
-      return Dungeon::Tile::StatueRight;
-    default:
-      return Dungeon::Tile::Room;
+Dungeon::Position Dungeon::room_origin(int room) const {
+  return layout_->rooms[room].origin;
+}
+
+int Dungeon::room_template(int room) const {
+  return layout_->rooms[room].room_template;
+}
+
+SubsetSum Dungeon::solution(int room) const {
+  return SubsetSum::solve(room_values(room), rooms_[room].target);
+}
+
+std::vector<int> Dungeon::room_values(int room) const {
+  std::vector<int> values;
+  for (const auto& p : layout_->rooms[room].values) {
+    values.push_back(get_cell(p.x, p.y).value);
   }
+  return values;
 }
-}  // namespace
 
-void Dungeon::load_room_data(const std::string& filename) {
-  std::array<Tile, 77> template_tiles;
-  int index = 0;
-  std::ifstream reader(filename);
-  std::string row;
-  while (std::getline(reader, row)) {
-    for (char c : row) {
-      if (c == '\n') continue;
-      template_tiles[index++] = tile_for_char(c);
-    }
-    if (index == 77) {
-      room_templates_.push_back(template_tiles);
-      index = 0;
+const std::vector<Dungeon::Position>& Dungeon::value_cells(int room) const {
+  return layout_->rooms[room].values;
+}
+
+std::vector<Dungeon::Door> Dungeon::doors(int room) const {
+  std::vector<Door> doors;
+  for (size_t d : layout_->rooms[room].doors) {
+    doors.push_back(layout_->doors[d]);
+  }
+  return doors;
+}
+
+std::vector<int> Dungeon::neighbors(int room) const {
+  std::vector<int> rooms;
+  for (size_t d : layout_->rooms[room].doors) {
+    const Door& door = layout_->doors[d];
+    const int other = door.from == room ? door.to : door.from;
+    if (other >= 0) rooms.push_back(other);
+  }
+  return rooms;
+}
+
+std::uint64_t Dungeon::checksum() const {
+  std::uint64_t hash = kHashBasis;
+  for (int n = 0; n < kRoomCount; ++n) {
+    hash = hash_value(hash, rooms_[n].running_total);
+    for (const auto& p : layout_->rooms[n].values) {
+      hash = hash_value(hash, get_cell(p.x, p.y).active);
     }
   }
+  for (const auto& door : layout_->doors) {
+    hash = hash_value(hash, get_cell(door.position.x, door.position.y).tile);
+  }
+  return hash;
 }
 
 constexpr Dungeon::Cell Dungeon::kBadCell;
+constexpr Dungeon::Cell Dungeon::kWallCell;
@@ -1,20 +1,20 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <random>
+#include <unordered_map>
 #include <vector>
 
-#include "config.h"
-#include "graphics.h"
-#include "rect.h"
-#include "sprite.h"
-#include "spritemap.h"
+#include "subset_sum.h"
 
+// Copies of a dungeon share everything neither of them has changed since,
+// so search agents can fork one for each move they try.
 class Dungeon {
  public:
-  enum class Tile {
+  enum class Tile : std::uint8_t {
     OutOfBounds,
     Wall,
     Room,
@@ -28,12 +28,19 @@ class Dungeon {
     StatueRight,
   };
 
-  enum class Result { None, Overload, Perfect };
+  enum class Result { None, Activated, Overload, Perfect };
 
+  // Classic dungeons are made whole up front.  Endless ones start with the
+  // entrance and a single room, gain a room each time the newest is solved
+  // and forget rooms the player can no longer get back to.
+  enum class Mode : std::uint8_t { Classic, Endless };
+
+  // Values are always below 100 and there are only a handful of rooms, so a
+  // cell fits in four bytes.
   struct Cell {
     Tile tile;
-    int room;
-    int value;
+    std::uint8_t room;
+    std::uint8_t value;
     bool active;
 
     bool is_door() const;
@@ -43,6 +50,27 @@ class Dungeon {
     int x, y;
   };
 
+  struct Box {
+    double left, top, right, bottom;
+  };
+
+  // A door between two rooms.  Doors leading out of the dungeon have a to
+  // room of -1.
+  struct Door {
+    Position position;
+    int from, to;
+  };
+
+  // A change made to the dungeon during play.  Everything else that
+  // changes follows from these, so making the dungeon again from its seed
+  // and replaying them brings it back to the same state.
+  struct Change {
+    enum class Kind : std::uint8_t { Activate, OpenDoor };
+
+    Kind kind;
+    Position position;
+  };
+
   struct Room {
     int target;
     int running_total;
@@ -55,57 +83,233 @@ class Dungeon {
     operator bool() const { return target > 0; }
   };
 
-  Dungeon(int width, int height, unsigned int seed);
+  static constexpr int kTileSize = 16;
+  // Rooms are kept in this many slots.  A classic room's slot is its
+  // number, while endless dungeons reuse the slots of forgotten rooms.
+  static constexpr int kRoomCount = 16;
+
+  // Every room's target is built from its values, so each can always be
+  // solved.  Every room is checked as it is placed all the same, and
+  // checked dungeons also make rooms that can't be solved again, which only
+  // tools looking into generation need.
+  Dungeon(int width, int height, unsigned int seed, Mode mode = Mode::Classic,
+          bool checked = false);
+
+  int width() const { return width_; }
+  int height() const { return height_; }
+  unsigned int seed() const { return seed_; }
+  Mode mode() const { return mode_; }
+  int attempts() const { return attempts_; }
+  // Changes whenever any cell does, so views of the dungeon can be cached.
+  unsigned int revision() const { return revision_; }
+  // Changes only when cells become walkable or stop being so, which is
+  // much rarer, so paths through the dungeon can be cached.
+  unsigned int layout_revision() const { return layout_revision_; }
 
   Position grid_coords(double px, double py) const;
 
-  const Cell& get_cell(int x, int y) const;
+  Cell get_cell(int x, int y) const;
   Position find_tile(Tile tile) const;
 
-  void draw(Graphics& graphics, int hud_height, int xo, int yo) const;
-  void draw_overlay(Graphics& graphics, int hud_height) const;
-
   bool walkable(int x, int y) const;
-  bool box_walkable(const Rect& r) const;
+  bool box_walkable(const Box& b) const;
+  // Tests many boxes at once, writing whether each is walkable.  Boxes near
+  // each other share block lookups, so keeping them grouped by room makes
+  // this cheaper than testing them one at a time.
+  void box_walkable(const Box* boxes, int count, bool* walkable) const;
+  // How far a box can move along one axis, up to the distance given, before
+  // it runs into a cell that can't be walked on.  Every cell passed over is
+  // checked, so long moves can't skip through walls.
+  double sweep_x(const Box& b, double dx) const;
+  double sweep_y(const Box& b, double dy) const;
 
   void open_door(int x, int y);
-  Result activate(int x, int y, Audio& audio);
+  Result activate(int x, int y);
+
+  // Every change made so far, oldest first.
+  std::vector<Change> journal() const;
+  // The same, into a vector whose memory is kept from the last time.
+  void journal(std::vector<Change>& changes) const;
+  size_t journal_size() const { return journal_.size(); }
+  void replay(const std::vector<Change>& journal);
 
   Room& get_room(int x, int y);
   const Room& get_room(int x, int y) const;
+  const Room& room(int room) const { return rooms_[room]; }
+
+  Position room_origin(int room) const;
+  int room_template(int room) const;
+  bool solvable(int room) const { return layout_->rooms[room].solvable; }
+  // Counts every solution, which is too slow to do for every room.
+  SubsetSum solution(int room) const;
+  const std::vector<Position>& value_cells(int room) const;
+  const std::vector<Door>& doors() const { return layout_->doors; }
+  std::vector<Door> doors(int room) const;
+  std::vector<int> neighbors(int room) const;
+
+  // Hash of everything that can change during play.
+  std::uint64_t checksum() const;
 
  private:
+  // Times the private parts of generation in tools/benchmarks.cc.
+  friend class DungeonBenchmarks;
+
   static constexpr int kMaxVisibility = 9;
+  static constexpr int kClassicRooms = 15;
+  // Past the classic rooms targets keep rising until this, and values stay
+  // at most five by five, the most any template has space for.
+  static constexpr int kMaxTarget = 500;
+  static constexpr int kMaxValueRows = 5;
+  // The newest room, the one solved to reach it and the one before that,
+  // which is still open to the player.  Anything older is sealed off.
+  static constexpr int kEndlessRooms = 3;
+  static constexpr int kBlockWidth = 12;
+  static constexpr int kBlockHeight = 8;
+  static constexpr int kBlockSize = kBlockWidth * kBlockHeight;
+  static constexpr int kMaskWords = (kBlockSize + 63) / 64;
   static constexpr Cell kBadCell = {Tile::OutOfBounds, 0, 0, false};
+  static constexpr Cell kWallCell = {Tile::Wall, 0, 0, false};
 
   enum class Direction { North, South, East, West };
   enum class RoomType { Entrance, Normal, Boss, Pedestal };
 
-  int width_, height_;
-  std::default_random_engine rng_;
-  Cell cells_[1024][1024];
-  Room rooms_[16];
-  mutable Tile door_tiles_[4];
+  struct RoomLayout {
+    Position origin;
+    int room_template;
+    std::vector<Position> values;
+    std::vector<size_t> doors;
+    // Whether some of the values add up to the target, checked as the room
+    // is placed.
+    bool solvable = true;
+  };
 
-  SpriteMap tiles_, ui_, doors_;
-  Sprite wall_overlay_;
+  // What only changes as rooms are placed or forgotten: where the rooms
+  // and doors are and where each block is kept in blocks_.
+  struct Layout {
+    RoomLayout rooms[kRoomCount];
+    std::vector<Door> doors;
+    std::unordered_map<int, int> blocks;
+  };
+
+  // Changes are kept in a list of chunks, newest first, that copies share.
+  // Copying a dungeon doesn't copy them, and new changes go in a chunk of
+  // their own once the newest is shared.
+  class Journal {
+   public:
+    Journal() : size_(0) {}
+    Journal(const Journal&) = default;
+    Journal(Journal&&) = default;
+    Journal& operator=(Journal other);
+    ~Journal() { release(); }
+
+    void add(Change change);
+    size_t size() const { return size_; }
+    void changes(std::vector<Change>& changes) const;
+
+   private:
+    static constexpr int kChunkSize = 16;
+
+    struct Chunk {
+      std::array<Change, kChunkSize> changes;
+      int count;
+      std::shared_ptr<const Chunk> previous;
+    };
+
+    std::shared_ptr<Chunk> head_;
+    size_t size_;
+
+    void release();
+  };
 
-  std::vector<std::array<Tile, 77>> room_templates_;
+  // Cells are stored in room-sized blocks aligned to the room grid, so only
+  // the blocks that rooms have been placed in take up any memory.  Every
+  // other in-bounds cell is solid wall.  Each field of the cells is kept in
+  // its own plane so that scanning for tiles or active cells stays compact.
+  // Tiles are only changed through set() so that the walkable bits, one per
+  // cell, always match them.
+  struct Block {
+    int x, y;
+    std::array<Tile, kBlockSize> tiles;
+    std::array<std::uint8_t, kBlockSize> rooms;
+    std::array<std::uint8_t, kBlockSize> values;
+    std::array<bool, kBlockSize> active;
+    std::array<std::uint64_t, kMaskWords> walkable;
+
+    int index(int cx, int cy) const { return (cy - y) * kBlockWidth + cx - x; }
+    bool contains(int cx, int cy) const {
+      return cx >= x && cx < x + kBlockWidth && cy >= y &&
+             cy < y + kBlockHeight;
+    }
+    Cell cell(int i) const {
+      return {tiles[i], rooms[i], values[i], active[i]};
+    }
+    std::uint64_t walkable_bit(int i) const {
+      return walkable[i / 64] >> (i % 64) & 1;
+    }
+    void set(int i, Tile tile) {
+      const std::uint64_t bit = std::uint64_t(1) << (i % 64);
+      tiles[i] = tile;
+      walkable[i / 64] &= ~bit;
+      walkable[i / 64] |= -tile_walkable(tile) & bit;
+    }
+  };
+
+  int width_, height_, origin_x_, origin_y_;
+  unsigned int seed_;
+  Mode mode_;
+  bool checked_;
+  int attempts_;
+  // Slot of the room endless dungeons grow from.
+  int newest_;
+  unsigned int revision_, layout_revision_;
+  std::default_random_engine rng_;
+  // Shared with copies until either of them changes it, so copying a
+  // dungeon costs a pointer for the layout and one for each block.
+  std::shared_ptr<Layout> layout_;
+  // Places are left empty when blocks are dropped, for new ones to use.
+  std::vector<std::shared_ptr<Block>> blocks_;
+  Room rooms_[kRoomCount];
+  Journal journal_;
+
+  static constexpr std::uint64_t tile_walkable(Tile tile) {
+    return tile == Tile::Room || tile == Tile::DoorOpen || tile == Tile::Sand;
+  }
 
   bool generate(unsigned int seed);
+  void generate_endless(unsigned int seed);
+  void extend(Tile door_tile);
+  bool room_fits(int x, int y) const;
+  void evict(int room);
+
+  // Unshares the layout, for changing it.
+  Layout& layout();
+
+  int block_key(int x, int y) const;
+  // Where the block holding a cell is kept in blocks_, or -1 if it has none.
+  int block_slot(int x, int y) const;
+  const Block* find_block(int x, int y) const;
+  // Unshares the block, for changing it.
+  Block* find_block(int x, int y);
+  Block& unshare_block(int slot);
+  Block& block(int x, int y);
+  void drop_block(int x, int y);
 
   void set_tile(int x, int y, Tile tile);
   Tile get_tile(int x, int y);
+  bool box_walkable(const Box& b, const Block*& near) const;
+  double sweep(double edge, double delta, int low, int high,
+               bool horizontal) const;
 
-  void place_room(int x, int y, int room, RoomType type);
-  void tile_room(int x, int y, RoomType type);
-  void place_room_value(int x, int y, int value);
-  bool try_place_door(int x, int y, int cx, int cy, Tile door_tile);
+  void place_room(int x, int y, int room, int number, RoomType type);
+  int tile_room(int x, int y, RoomType type);
+  Position place_room_value(int x, int y, int value);
+  bool try_place_door(int x, int y, int cx, int cy, int room, Tile door_tile);
+  void add_door(int x, int y, int from, int to);
+  std::vector<int> room_values(int room) const;
   std::vector<int> divide(int target, size_t max_count);
   int random_in_range(int min, int max);
+  void record(Change::Kind kind, int x, int y);
   void clear_active_cells(int room);
   void unlock_doors(int room);
-  void draw_door_frame(Graphics& graphics, Tile tile, int x, int y) const;
-  void load_room_data(const std::string& file);
   void apply_template(int x, int y, int n);
 };
@@ -0,0 +1,170 @@
+#include "dungeon_renderer.h"
+
+#include <algorithm>
+
+#include "allocations.h"
+#include "assets.h"
+#include "config.h"
+#include "profiler.h"
+#include "ui.h"
+
+static_assert(Dungeon::kTileSize == Config::kTileSize,
+              "dungeon and graphics tile sizes differ");
+
+namespace {
+int floor_div(int a, int b) { return a / b - (a % b != 0 && a < 0); }
+int ceil_div(int a, int b) { return -floor_div(-a, b); }
+
+constexpr auto kFloor = RenderQueue::Layer::Floor;
+constexpr auto kNumbers = RenderQueue::Layer::Numbers;
+}  // namespace
+
+DungeonRenderer::DungeonRenderer()
+    : tiles_(Assets::get().sprite_map("tiles.png", 4, Config::kTileSize,
+                                      Config::kTileSize)),
+      ui_(Assets::get().sprite_map("ui.png", 10, Config::kHalfTile,
+                                   Config::kHalfTile)),
+      doors_(Assets::get().sprite_map("doors.png", 8, Config::kTileSize,
+                                      Config::kTileSize)),
+      wall_overlay_(Assets::get().sprite("room-overlay.png", 0, 0, 256, 176)),
+      view_() {
+  // At most a tile and two digits for every cell that can be on screen.
+  const int ts = Config::kTileSize;
+  draws_.reserve(3 * (kConfig.graphics.width / ts + 2) *
+                 (kConfig.graphics.height / ts + 2));
+}
+
+void DungeonRenderer::draw(RenderQueue& queue, const Dungeon& dungeon,
+                           int hud_height, int xo, int yo) const {
+  PROFILE_ZONE("DungeonRenderer::draw");
+  const View view = {&dungeon, dungeon.revision(), xo, yo, hud_height,
+                     queue.width(), queue.height()};
+  if (!(view == view_)) build(view);
+
+  for (const auto& d : draws_) {
+    queue.set_layer(d.layer);
+    queue.draw(*d.sprites, d.n, d.x, d.y);
+  }
+}
+
+void DungeonRenderer::build(const View& view) const {
+  view_ = view;
+  draws_.clear();
+
+  door_tiles_[0] = Dungeon::Tile::Wall;
+  door_tiles_[1] = Dungeon::Tile::Wall;
+  door_tiles_[2] = Dungeon::Tile::Wall;
+  door_tiles_[3] = Dungeon::Tile::Wall;
+
+  const Dungeon& dungeon = *view.dungeon;
+  const int ts = Config::kTileSize;
+  const int y0 = std::max(0, ceil_div(view.yo + view.top - ts, ts));
+  const int y1 =
+      std::min(dungeon.height() - 1, floor_div(view.yo + view.height, ts));
+  const int x0 = std::max(0, ceil_div(view.xo - ts, ts));
+  const int x1 =
+      std::min(dungeon.width() - 1, floor_div(view.xo + view.width, ts));
+
+  for (int y = y0; y <= y1; ++y) {
+    const int gy = ts * y - view.yo;
+    for (int x = x0; x <= x1; ++x) {
+      const int gx = ts * x - view.xo;
+
+      const auto cell = dungeon.get_cell(x, y);
+      if (cell.is_door()) {
+        if (gy == 96) {
+          draws_.push_back({doors_.get(), kFloor, 32, gx, gy});
+          door_tiles_[0] = cell.tile;
+        } else if (gy == 224) {
+          draws_.push_back({doors_.get(), kFloor, 40, gx, gy});
+          door_tiles_[1] = cell.tile;
+        } else if (gx == 24) {
+          draws_.push_back({doors_.get(), kFloor, 48, gx, gy});
+          door_tiles_[2] = cell.tile;
+        } else if (gx == 216) {
+          draws_.push_back({doors_.get(), kFloor, 56, gx, gy});
+          door_tiles_[3] = cell.tile;
+        }
+      } else if (cell.tile == Dungeon::Tile::Wall) {
+        if (gy == 96) draws_.push_back({doors_.get(), kFloor, 27, gx, gy});
+        if (gy == 224) draws_.push_back({doors_.get(), kFloor, 28, gx, gy});
+        if (gx == 24) draws_.push_back({doors_.get(), kFloor, 29, gx, gy});
+        if (gx == 216) draws_.push_back({doors_.get(), kFloor, 30, gx, gy});
+      } else {
+        const int tile = static_cast<int>(cell.tile);
+        draws_.push_back({tiles_.get(), kFloor, tile, gx, gy});
+        if (cell.value > 0) {
+          const int vx = cell.value > 9 ? gx : gx + Config::kQuarterTile;
+          const int vy = gy + Config::kQuarterTile;
+          const auto vc = cell.active ? UI::Color::Cyan : UI::Color::Black;
+          UI::Glyph glyphs[UI::kMaxDigits];
+          const int n =
+              UI::layout_small_number(vx, vy, cell.value, vc, glyphs);
+          for (const auto* g = glyphs; g < glyphs + n; ++g) {
+            draws_.push_back({ui_.get(), kNumbers, g->sprite, g->x, g->y});
+          }
+        }
+      }
+    }
+  }
+  PROFILE_COUNT(CellsScanned,
+                std::max(0, y1 - y0 + 1) * std::max(0, x1 - x0 + 1));
+}
+
+#define DRAW_DOOR_TILE(n, ox, oy)                         \
+  queue.draw(*doors_, (n), x + (ox) * Config::kTileSize, \
+             y + (oy) * Config::kTileSize)
+
+void DungeonRenderer::draw_door_frame(RenderQueue& queue, Dungeon::Tile tile,
+                                      int x, int y) const {
+  if (tile == Dungeon::Tile::Wall) return;
+
+  if (y == 96) {  // north door
+    DRAW_DOOR_TILE(0, -1, -1);
+    DRAW_DOOR_TILE(1, 0, -1);
+    DRAW_DOOR_TILE(2, 1, -1);
+    DRAW_DOOR_TILE(8, -1, 0);
+    if (tile == Dungeon::Tile::DoorLocked) DRAW_DOOR_TILE(33, 0, 0);
+    if (tile == Dungeon::Tile::DoorClosed) DRAW_DOOR_TILE(36, 0, 0);
+    DRAW_DOOR_TILE(10, 1, 0);
+  } else if (y == 224) {  // south door
+    DRAW_DOOR_TILE(16, -1, 0);
+    if (tile == Dungeon::Tile::DoorLocked) DRAW_DOOR_TILE(41, 0, 0);
+    if (tile == Dungeon::Tile::DoorClosed) DRAW_DOOR_TILE(44, 0, 0);
+    DRAW_DOOR_TILE(18, 1, 0);
+    DRAW_DOOR_TILE(24, -1, 1);
+    DRAW_DOOR_TILE(25, 0, 1);
+    DRAW_DOOR_TILE(26, 1, 1);
+  } else if (x == 24) {  // west door
+    DRAW_DOOR_TILE(3, -1, -1);
+    DRAW_DOOR_TILE(4, 0, -1);
+    DRAW_DOOR_TILE(11, -1, 0);
+    if (tile == Dungeon::Tile::DoorLocked) DRAW_DOOR_TILE(49, 0, 0);
+    if (tile == Dungeon::Tile::DoorClosed) DRAW_DOOR_TILE(52, 0, 0);
+    DRAW_DOOR_TILE(19, -1, 1);
+    DRAW_DOOR_TILE(20, 0, 1);
+  } else if (x == 216) {  // east door
+    DRAW_DOOR_TILE(5, 0, -1);
+    DRAW_DOOR_TILE(6, 1, -1);
+    if (tile == Dungeon::Tile::DoorLocked) DRAW_DOOR_TILE(57, 0, 0);
+    if (tile == Dungeon::Tile::DoorClosed) DRAW_DOOR_TILE(60, 0, 0);
+    DRAW_DOOR_TILE(14, 1, 0);
+    DRAW_DOOR_TILE(21, 0, 1);
+    DRAW_DOOR_TILE(22, 1, 1);
+  }
+}
+
+void DungeonRenderer::draw_overlay(RenderQueue& queue, int hud_height) const {
+  PROFILE_ZONE("DungeonRenderer::draw_overlay");
+  queue.flush();
+  if (queue.has_graphics()) {
+    // Whatever gam does to draw a sprite is out of our hands.
+    Allocations::Exempt exempt;
+    wall_overlay_->draw(queue.graphics(), 0, hud_height);
+  }
+  queue.set_layer(RenderQueue::Layer::DoorFrames);
+  draw_door_frame(queue, door_tiles_[0], 120, 96);
+  draw_door_frame(queue, door_tiles_[1], 120, 224);
+  draw_door_frame(queue, door_tiles_[2], 24, 160);
+  draw_door_frame(queue, door_tiles_[3], 216, 160);
+}
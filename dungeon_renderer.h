@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "dungeon.h"
+#include "graphics.h"
+#include "render_queue.h"
+#include "sprite.h"
+#include "spritemap.h"
+
+class DungeonRenderer {
+ public:
+  DungeonRenderer();
+
+  void draw(RenderQueue& queue, const Dungeon& dungeon, int hud_height, int xo,
+            int yo) const;
+  void draw_overlay(RenderQueue& queue, int hud_height) const;
+
+ private:
+  struct Draw {
+    const SpriteMap* sprites;
+    RenderQueue::Layer layer;
+    int n, x, y;
+  };
+
+  // The camera only ever stops on the room grid, so the tiles of a view
+  // are worked out once and replayed every frame until the camera moves or
+  // a cell of the dungeon changes.
+  struct View {
+    const Dungeon* dungeon;
+    unsigned int revision;
+    int xo, yo, top, width, height;
+
+    bool operator==(const View& other) const {
+      return dungeon == other.dungeon && revision == other.revision &&
+             xo == other.xo && yo == other.yo && top == other.top &&
+             width == other.width && height == other.height;
+    }
+  };
+
+  std::shared_ptr<const SpriteMap> tiles_, ui_, doors_;
+  std::shared_ptr<const Sprite> wall_overlay_;
+  mutable Dungeon::Tile door_tiles_[4];
+  mutable View view_;
+  mutable std::vector<Draw> draws_;
+
+  void build(const View& view) const;
+  void draw_door_frame(RenderQueue& queue, Dungeon::Tile tile, int x,
+                       int y) const;
+};
@@ -1,21 +1,94 @@
 #include "dungeon_screen.h"
 
+#include <cstdio>
+#include <utility>
+
+#include "allocations.h"
+#include "assets.h"
 #include "title_screen.h"
-#include "util.h"
 
-DungeonScreen::DungeonScreen()
-    : text_("text.png"),
-      camera_(),
-      dungeon_(1024, 1024, Util::random_seed()),
+Dungeon DungeonScreen::generate(unsigned int seed, Dungeon::Mode mode) {
+  return Dungeon(kDungeonSize, kDungeonSize, seed, mode);
+}
+
+DungeonScreen::DungeonScreen(unsigned int seed, Dungeon dungeon,
+                             bool enemies)
+    : camera_(),
+      seed_(seed),
+      dungeon_(std::move(dungeon)),
+      renderer_(),
+      queue_(),
       player_(0, 0),
+      enemies_(),
       state_(State::FadeIn),
       hud_(),
-      timer_(0) {
+      replay_(seed_, dungeon_.mode(), enemies),
+      timer_(0),
+      frames_(0),
+      saved_(dungeon_.journal_size()),
+      saved_health_(player_.health()),
+      save_(),
+      save_data_(),
+      save_writer_(kSaveFile),
+      restored_(false),
+      next_seed_(0),
+      next_() {
   player_.set_position(512 * 16 - 8, 1023 * 16);
+  if (enemies) enemies_.emplace(seed);
+
+#ifdef PROFILING
+  text_ = Assets::get().text("text.png");
+  profiling_ = false;
+  zone_times_ = {};
+  line_.reserve(kLineSize);
+#endif
+}
+
+DungeonScreen::DungeonScreen(const SaveGame& save)
+    : DungeonScreen(save.seed(), save.dungeon(kDungeonSize), save.enemies()) {
+  save.restore(player_);
+  if (enemies_) save.restore(*enemies_);
+  saved_health_ = player_.health();
+  restored_ = true;
+}
+
+// Runs are only replayed from the start, so the replay waits until the run
+// is over and the screen is going.
+DungeonScreen::~DungeonScreen() {
+  if (player_.dead() && !restored_) replay_.save(kReplayFile);
+}
+
+void DungeonScreen::pass_on(unsigned int seed, std::future<Dungeon> dungeon) {
+  next_seed_ = seed;
+  next_ = std::move(dungeon);
 }
 
 bool DungeonScreen::update(const Input& input, Audio& audio,
                            unsigned int elapsed) {
+  Allocations::Check check(frames_ >= kWarmupFrames);
+#ifdef PROFILING
+  update_profiler(input);
+#endif
+
+  unsigned int buttons = 0;
+  if (input.key_held(Input::Button::Left)) buttons |= Player::kLeft;
+  if (input.key_held(Input::Button::Right)) buttons |= Player::kRight;
+  if (input.key_held(Input::Button::Up)) buttons |= Player::kUp;
+  if (input.key_held(Input::Button::Down)) buttons |= Player::kDown;
+  if (input.key_pressed(Input::Button::A)) buttons |= Player::kInteract;
+  if (input.key_pressed(Input::Button::B)) buttons |= Player::kFocus;
+  return update(buttons, audio, elapsed);
+}
+
+bool DungeonScreen::update(unsigned int buttons, Audio& audio,
+                           unsigned int elapsed) {
+  Allocations::Check check(++frames_ > kWarmupFrames);
+  PROFILE_ZONE("DungeonScreen::update");
+
+  // Buttons are only recorded while playing.  Outside of that the player is
+  // standing still or dying, where having no buttons held changes nothing.
+  if (state_ != State::Playing) buttons = 0;
+
   if (state_ == State::FadeIn) {
     timer_ += elapsed;
     if (timer_ > kFadeTimer) {
@@ -25,7 +98,10 @@ bool DungeonScreen::update(const Input& input, Audio& audio,
   } else if (state_ == State::FadeOut) {
     timer_ += elapsed;
     if (timer_ > kFadeTimer) {
-      if (player_.dead()) return false;
+      if (player_.dead()) {
+        save_writer_.remove();
+        return false;
+      }
 
       timer_ = 0;
       state_ = State::FadeIn;
@@ -33,56 +109,158 @@ bool DungeonScreen::update(const Input& input, Audio& audio,
       return true;
     }
   } else {
-    if (input.key_held(Input::Button::Left)) {
-      player_.move(Player::Direction::West);
-    } else if (input.key_held(Input::Button::Right)) {
-      player_.move(Player::Direction::East);
-    } else if (input.key_held(Input::Button::Up)) {
-      player_.move(Player::Direction::North);
-    } else if (input.key_held(Input::Button::Down)) {
-      player_.move(Player::Direction::South);
-    } else {
-      player_.stop();
-    }
-
-    if (input.key_pressed(Input::Button::A)) {
-      if (!player_.interact(dungeon_, audio)) player_.attack();
-    }
-
-    if (input.key_pressed(Input::Button::B)) {
-      audio.play_sample("focus.wav");
-      player_.focus();
-    }
+    player_.control(dungeon_, buttons);
 
     if (player_.dead()) state_ = State::FadeOut;
   }
 
-  player_.update(dungeon_, elapsed, audio);
+  replay_.record(buttons, elapsed);
+  player_.update(dungeon_, elapsed);
+  if (enemies_) enemies_->update(dungeon_, player_, elapsed);
   camera_.update(player_);
 
+  // Runs are saved whenever the dungeon changes or the player is hurt,
+  // which is only a few times a room, and never once the player is dying.
+  if (player_.alive() && (dungeon_.journal_size() != saved_ ||
+                          player_.health() != saved_health_)) {
+    save_.update(seed_, dungeon_, player_, enemies_ ? &*enemies_ : nullptr);
+    save_.write(save_data_);
+    save_writer_.write(save_data_);
+    saved_ = dungeon_.journal_size();
+    saved_health_ = player_.health();
+  }
+
+  const unsigned int sounds = player_.take_sounds();
+  for (int i = 0; i < Player::kSoundCount; ++i) {
+    if (sounds & (1u << i)) {
+      // gam loads samples the first time they are played.
+      Allocations::Exempt exempt;
+      audio.play_sample(Player::sound_file(static_cast<Player::Sound>(i)));
+    }
+  }
+
   return true;
 }
 
 void DungeonScreen::draw(Graphics& graphics) const {
+  queue_.begin(graphics);
+  draw_frame();
+}
+
+void DungeonScreen::draw(int width, int height) const {
+  queue_.begin(width, height);
+  draw_frame();
+}
+
+// Fades, the HUD's backing and the profiler go straight to the graphics, so
+// are left out of frames without any.
+void DungeonScreen::draw_frame() const {
+  Allocations::Check check(frames_ > kWarmupFrames);
+  PROFILE_ZONE("DungeonScreen::draw");
   const int xo = camera_.xoffset();
   const int yo = camera_.yoffset();
 
-  dungeon_.draw(graphics, kHudHeight, xo, yo);
-  dungeon_.draw_overlay(graphics, kHudHeight);
-  player_.draw(graphics, xo, yo);
+  renderer_.draw(queue_, dungeon_, kHudHeight, xo, yo);
+  renderer_.draw_overlay(queue_, kHudHeight);
+  if (enemies_) enemies_->draw(queue_, xo, yo);
+  player_.draw(queue_, xo, yo);
+  queue_.flush();
+
+  if (queue_.has_graphics()) {
+    Graphics& graphics = queue_.graphics();
+    if (state_ == State::FadeIn || state_ == State::FadeOut) {
+      const double pct = timer_ / (double)kFadeTimer;
+      const int width = (int)((state_ == State::FadeOut ? pct : 1 - pct) *
+                              graphics.width() / 2);
+
+      graphics.draw_rect({0, 0}, {width, graphics.height()}, 0x000000ff,
+                         true);
+      graphics.draw_rect({graphics.width() - width, 0},
+                         {graphics.width(), graphics.height()}, 0x000000ff,
+                         true);
+    }
+
+    graphics.draw_rect({0, 0}, {graphics.width(), kHudHeight}, 0x000000ff,
+                       true);
+  }
+  hud_.draw(queue_, player_, dungeon_);
+  queue_.flush();
+
+#ifdef PROFILING
+  if (profiling_ && queue_.has_graphics()) draw_profiler(queue_.graphics());
+#endif
+}
+
+#ifdef PROFILING
+void DungeonScreen::update_profiler(const Input& input) {
+  Profiler::frame();
 
-  if (state_ == State::FadeIn || state_ == State::FadeOut) {
-    const double pct = timer_ / (double)kFadeTimer;
-    const int width = (int)((state_ == State::FadeOut ? pct : 1 - pct) *
-                            graphics.width() / 2);
+  if (input.key_pressed(Input::Button::Select)) {
+    profiling_ = !profiling_;
+    // Closing the overlay keeps the frames it was showing for later.
+    if (!profiling_) {
+      // Only when asked for, and the trace is built up as it is written.
+      Allocations::Exempt exempt;
+      Profiler::write_trace(kTraceFile);
+    }
+  }
 
-    graphics.draw_rect({0, 0}, {width, graphics.height()}, 0x000000ff, true);
-    graphics.draw_rect({graphics.width() - width, 0},
-                       {graphics.width(), graphics.height()}, 0x000000ff, true);
+  if (profiling_ && frames_ % kProfileRefresh == 0) {
+    Profiler::percentiles(zone_times_);
   }
+}
+
+void DungeonScreen::draw_profiler(Graphics& graphics) const {
+  const int line = Config::kHalfTile;
+  const int zones = Profiler::zone_count();
+  graphics.draw_rect({0, kHudHeight},
+                     {graphics.width(), kHudHeight + (zones + 4) * line},
+                     0x000000c0, true);
 
-  graphics.draw_rect({0, 0}, {graphics.width(), kHudHeight}, 0x000000ff, true);
-  hud_.draw(graphics, player_, dungeon_);
+  // Lines are put together in memory kept for them, leaving only gam's
+  // drawing of the text, which is out of our hands.
+  char buffer[kLineSize];
+  auto print = [this, &graphics, &buffer](int y) {
+    line_ = buffer;
+    Allocations::Exempt exempt;
+    text_->draw(graphics, line_, 0, y);
+  };
+
+  int y = kHudHeight;
+  std::snprintf(buffer, sizeof(buffer), "cells %llu  sprites %llu",
+                static_cast<unsigned long long>(Profiler::frame_count(
+                    Profiler::Counter::CellsScanned)),
+                static_cast<unsigned long long>(Profiler::frame_count(
+                    Profiler::Counter::SpritesDrawn)));
+  print(y);
+
+  // The frame's stats are complete once the HUD has been flushed.
+  const auto& stats = queue_.stats();
+  y += line;
+  std::snprintf(buffer, sizeof(buffer), "draws %d  switches %d (%d unsorted)",
+                stats.draws, stats.switches, stats.unsorted_switches);
+  print(y);
+
+  const auto& assets = Assets::get();
+  y += line;
+  std::snprintf(buffer, sizeof(buffer), "assets %zu  textures %zuk",
+                assets.count(), assets.texture_bytes() / 1024);
+  print(y);
+
+  y += line;
+  std::snprintf(buffer, sizeof(buffer), "  p50us  p99us zone");
+  print(y);
+  for (int i = 0; i < zones; ++i) {
+    const auto& t = zone_times_[i];
+    y += line;
+    std::snprintf(buffer, sizeof(buffer), "%7.1f%7.1f %s", t.p50 / 1000.0,
+                  t.p99 / 1000.0, Profiler::zone_name(i));
+    print(y);
+  }
 }
+#endif
 
-Screen* DungeonScreen::next_screen() const { return new TitleScreen(); }
+Screen* DungeonScreen::next_screen() const {
+  if (next_.valid()) return new TitleScreen(next_seed_, std::move(next_));
+  return new TitleScreen();
+}
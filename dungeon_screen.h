@@ -1,37 +1,111 @@
 #pragma once
 
+#include <array>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+
 #include "audio.h"
 #include "backdrop.h"
 #include "camera.h"
 #include "config.h"
+#include "dungeon_renderer.h"
+#include "enemies.h"
 #include "graphics.h"
 #include "hud.h"
 #include "input.h"
 #include "player.h"
+#include "profiler.h"
+#include "render_queue.h"
+#include "replay.h"
+#include "save_game.h"
+#include "save_writer.h"
 #include "screen.h"
 #include "text.h"
 
 class DungeonScreen : public Screen {
  public:
-  DungeonScreen();
+  static constexpr int kDungeonSize = 1024;
+  static constexpr const char* kSaveFile = "last.save";
+  static constexpr const char* kReplayFile = "last.replay";
+  // Frames after this many are checked for heap allocations in debug builds.
+  static constexpr int kWarmupFrames = 60;
+
+  // Dungeons take long enough to make that they are best made ahead of
+  // time, away from the screen that will play them.
+  static Dungeon generate(unsigned int seed,
+                          Dungeon::Mode mode = Dungeon::Mode::Classic);
+
+  DungeonScreen(unsigned int seed, Dungeon dungeon, bool enemies = false);
+  // Carries on with a saved run.
+  explicit DungeonScreen(const SaveGame& save);
+  ~DungeonScreen() override;
+
+  // Takes a classic dungeon the title screen was still making, to hand back
+  // to the one shown after this run rather than wait for it now.
+  void pass_on(unsigned int seed, std::future<Dungeon> dungeon);
 
   bool update(const Input& input, Audio& audio, unsigned int elapsed) override;
+  // Plays a frame with the given Player buttons held, as replays do.
+  bool update(unsigned int buttons, Audio& audio, unsigned int elapsed);
   void draw(Graphics& graphics) const override;
+  // Draws a frame with nothing to draw it to, which still does everything
+  // up to the point where gam would draw.
+  void draw(int width, int height) const;
 
   Screen* next_screen() const override;
   std::string get_music_track() const override { return "music.ogg"; }
 
+  const Replay& replay() const { return replay_; }
+  const RenderQueue::Stats& render_stats() const { return queue_.stats(); }
+
  private:
   enum class State { FadeIn, Playing, Pause, FadeOut };
 
   static constexpr int kHudHeight = 5 * Config::kTileSize;
   static constexpr int kFadeTimer = 1000;
+  static constexpr const char* kTraceFile = "profile.json";
+  // Frames between updates of the profiler overlay.
+  static constexpr int kProfileRefresh = 30;
+  // Longest line of the profiler overlay.
+  static constexpr int kLineSize = 64;
 
-  Text text_;
   Camera camera_;
+  unsigned int seed_;
   Dungeon dungeon_;
+  DungeonRenderer renderer_;
+  mutable RenderQueue queue_;
   Player player_;
+  // Only there if the run has enemies.
+  std::optional<Enemies> enemies_;
   State state_;
   HUD hud_;
-  int timer_;
+  Replay replay_;
+  int timer_, frames_;
+  // Length of the dungeon's journal and the player's health when the run
+  // was last saved.
+  size_t saved_;
+  int saved_health_;
+  // Saves are laid out here, in memory kept from one save to the next, and
+  // written to disk on the writer's own thread.
+  SaveGame save_;
+  std::string save_data_;
+  SaveWriter save_writer_;
+  // Restored runs don't start from the seed, so can't be replayed.
+  bool restored_;
+  unsigned int next_seed_;
+  mutable std::future<Dungeon> next_;
+
+  void draw_frame() const;
+
+#ifdef PROFILING
+  std::shared_ptr<const Text> text_;
+  bool profiling_;
+  std::array<Profiler::Percentiles, Profiler::kMaxZones> zone_times_;
+  mutable std::string line_;
+
+  void update_profiler(const Input& input);
+  void draw_profiler(Graphics& graphics) const;
+#endif
 };
@@ -0,0 +1,439 @@
+#include "enemies.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+#include "assets.h"
+#include "hash.h"
+#include "profiler.h"
+#include "room_templates.h"
+#include "varint.h"
+
+namespace {
+
+Dungeon::Box box_at(double x, double y, double extent) {
+  return {x - extent, y - extent, x + extent, y + extent};
+}
+
+template <typename T, size_t N>
+std::uint64_t hash_values(std::uint64_t hash, const std::array<T, N>& values,
+                          int count) {
+  return hash_bytes(hash, values.data(), count * sizeof(T));
+}
+
+}  // namespace
+
+const std::array<Enemies::Type, Enemies::kKindCount> Enemies::kTypes = {{
+    // Slimes wander about slowly and take two hits.
+    {0, 2, 1, 0.02, 1000, 0},
+    // Bats are fragile but quick, and go for the player when close.
+    {2, 1, 1, 0.05, 300, 5 * Config::kTileSize},
+}};
+
+Enemies::Enemies(unsigned int seed)
+    : sprites_(Assets::get().sprite_map("enemies.png", 4, Config::kTileSize,
+                                        Config::kTileSize)),
+      seed_(seed),
+      rng_(),
+      groups_(),
+      hash_(std::make_shared<SpatialHash>(kKindCount * kCapacity)),
+      field_(),
+      deepest_(0),
+      spawned_(0) {
+  rng_.seed(seed);
+  for (auto& g : groups_) g = std::make_shared<Group>();
+}
+
+void Enemies::seed(unsigned int seed) {
+  seed_ = seed;
+  rng_.seed(seed);
+}
+
+void Enemies::clear() {
+  for (int k = 0; k < kKindCount; ++k) {
+    if (groups_[k]->count > 0) group(k).count = 0;
+  }
+  field_ = FlowField();
+  deepest_ = 0;
+  spawned_ = 0;
+}
+
+bool Enemies::spawn(Kind kind, double x, double y) {
+  if (count(kind) == kCapacity) return false;
+  Group& g = group(static_cast<int>(kind));
+
+  const int i = g.count++;
+  g.x[i] = x;
+  g.y[i] = y;
+  g.facing[i] = Entity::Direction::South;
+  g.knockback[i] = Entity::Direction::South;
+  g.state[i] = State::Waiting;
+  g.hp[i] = kTypes[static_cast<int>(kind)].hp;
+  g.timer[i] = 0;
+  g.think[i] = 0;
+  g.iframes[i] = 0;
+  g.kbtimer[i] = 0;
+  const std::uint64_t stream = hash_value(hash_value(kHashBasis, seed_),
+                                          spawned_++);
+  g.rng[i].seed(static_cast<std::uint32_t>(stream ^ stream >> 32));
+  return true;
+}
+
+void Enemies::update(const Dungeon& dungeon, Player& player,
+                     unsigned int elapsed) {
+  PROFILE_ZONE("Enemies::update");
+  populate(dungeon, player);
+
+  field_.update(dungeon, dungeon.grid_coords(player.x(), player.y()));
+  for (int k = 0; k < kKindCount; ++k) {
+    think(group(k), kTypes[k], dungeon, player, elapsed);
+    move(group(k), kTypes[k], dungeon, player, elapsed);
+  }
+  index();
+  fight(player);
+  for (int k = 0; k < kKindCount; ++k) bury(group(k), dungeon, elapsed);
+}
+
+void Enemies::draw(RenderQueue& queue, int xo, int yo) const {
+  PROFILE_ZONE("Enemies::draw");
+  queue.set_layer(RenderQueue::Layer::Entities);
+
+  for (int k = 0; k < kKindCount; ++k) {
+    const Group& g = *groups_[k];
+    for (int i = 0; i < g.count; ++i) {
+      const int x = (int)g.x[i] - Config::kHalfTile - xo;
+      const int y = (int)g.y[i] - Config::kHalfTile - yo;
+      if (x <= -Config::kTileSize || x >= queue.width()) continue;
+      if (y <= -Config::kTileSize || y >= queue.height()) continue;
+      if (g.iframes[i] > 0 && (g.iframes[i] / 32) % 2 == 0) continue;
+
+      if (g.state[i] == State::Dying) {
+        int n = g.timer[i] / Entity::kDeathFrame;
+        if (n > 2) n = 4 - n;
+        queue.draw(*sprites_, n + 8, x, y);
+      } else {
+        const int frame = g.timer[i] / kAnimationTime;
+        queue.draw_flip(*sprites_, kTypes[k].sprite + frame, x, y,
+                        g.facing[i] == Entity::Direction::West, false);
+      }
+    }
+  }
+}
+
+int Enemies::count() const {
+  int total = 0;
+  for (const auto& g : groups_) total += g->count;
+  return total;
+}
+
+std::uint64_t Enemies::checksum() const {
+  std::uint64_t hash = hash_value(kHashBasis, deepest_);
+  hash = hash_value(hash, spawned_);
+  for (const auto& pool : groups_) {
+    const Group& g = *pool;
+    hash = hash_value(hash, g.count);
+    hash = hash_values(hash, g.x, g.count);
+    hash = hash_values(hash, g.y, g.count);
+    hash = hash_values(hash, g.facing, g.count);
+    hash = hash_values(hash, g.knockback, g.count);
+    hash = hash_values(hash, g.state, g.count);
+    hash = hash_values(hash, g.hp, g.count);
+    hash = hash_values(hash, g.timer, g.count);
+    hash = hash_values(hash, g.think, g.count);
+    hash = hash_values(hash, g.iframes, g.count);
+    hash = hash_values(hash, g.kbtimer, g.count);
+    hash = hash_values(hash, g.rng, g.count);
+  }
+  return hash;
+}
+
+void Enemies::save(std::string& out) const {
+  put_varint(out, rng_.state);
+  put_varint(out, deepest_);
+  put_varint(out, spawned_);
+  for (const auto& pool : groups_) {
+    const Group& g = *pool;
+    put_varint(out, g.count);
+    for (int i = 0; i < g.count; ++i) {
+      put_double(out, g.x[i]);
+      put_double(out, g.y[i]);
+      out.push_back(static_cast<char>(g.facing[i]));
+      out.push_back(static_cast<char>(g.knockback[i]));
+      out.push_back(static_cast<char>(g.state[i]));
+      put_varint(out, g.hp[i]);
+      put_varint(out, g.timer[i]);
+      put_varint(out, g.think[i]);
+      put_varint(out, g.iframes[i]);
+      put_varint(out, g.kbtimer[i]);
+      put_varint(out, g.rng[i].state);
+    }
+  }
+}
+
+bool Enemies::load(const std::string& in, size_t& pos) {
+  auto get_int = [&in, &pos](int& value) {
+    std::uint32_t bits;
+    if (!get_varint(in, pos, bits)) return false;
+    value = static_cast<int>(bits);
+    return true;
+  };
+  auto get_byte = [&in, &pos](std::uint8_t& value, int count) {
+    if (pos >= in.size()) return false;
+    value = static_cast<std::uint8_t>(in[pos++]);
+    return value < count;
+  };
+  auto get_random = [&in, &pos](Random& random) {
+    return get_varint(in, pos, random.state) &&
+           random.state >= Random::min() && random.state <= Random::max();
+  };
+
+  Random rng;
+  int deepest;
+  std::uint32_t spawned;
+  if (!get_random(rng) || !get_int(deepest) ||
+      !get_varint(in, pos, spawned)) {
+    return false;
+  }
+
+  std::array<std::shared_ptr<Group>, kKindCount> groups;
+  for (auto& pool : groups) {
+    pool = std::make_shared<Group>();
+    Group& g = *pool;
+    if (!get_int(g.count) || g.count < 0 || g.count > kCapacity) return false;
+    for (int i = 0; i < g.count; ++i) {
+      std::uint8_t facing, knockback, state;
+      if (!get_double(in, pos, g.x[i]) || !get_double(in, pos, g.y[i]) ||
+          !get_byte(facing, 4) || !get_byte(knockback, 4) ||
+          !get_byte(state, 4) || !get_int(g.hp[i]) || !get_int(g.timer[i]) ||
+          !get_int(g.think[i]) || !get_int(g.iframes[i]) ||
+          !get_int(g.kbtimer[i]) || !get_random(g.rng[i])) {
+        return false;
+      }
+      g.facing[i] = static_cast<Entity::Direction>(facing);
+      g.knockback[i] = static_cast<Entity::Direction>(knockback);
+      g.state[i] = static_cast<State>(state);
+    }
+  }
+
+  rng_ = rng;
+  groups_ = std::move(groups);
+  field_ = FlowField();
+  deepest_ = deepest;
+  spawned_ = spawned;
+  return true;
+}
+
+Enemies::Group& Enemies::group(int kind) {
+  auto& g = groups_[kind];
+  if (g.use_count() > 1) g = std::make_shared<Group>(*g);
+  return *g;
+}
+
+// Rooms are numbered in the order they are reached, so a room is new when
+// its number is higher than any seen before.
+void Enemies::populate(const Dungeon& dungeon, const Player& player) {
+  const auto p = dungeon.grid_coords(player.x(), player.y());
+  const auto cell = dungeon.get_cell(p.x, p.y);
+  if (!dungeon.walkable(p.x, p.y) || cell.is_door()) return;
+
+  const int number = dungeon.room(cell.room).number;
+  if (number <= deepest_) return;
+  deepest_ = number;
+
+  const int crowd = std::min(number, kCrowdedRoom);
+  const int counts[kKindCount] = {1 + crowd / 2, crowd / 3};
+
+  const auto o = dungeon.room_origin(cell.room);
+  std::uniform_int_distribution<int> rand_x(1, RoomTemplates::kWidth);
+  std::uniform_int_distribution<int> rand_y(1, RoomTemplates::kHeight);
+  for (int k = 0; k < kKindCount; ++k) {
+    for (int n = 0; n < counts[k]; ++n) {
+      for (int tries = 0; tries < kSpawnTries; ++tries) {
+        const int x = o.x + rand_x(rng_);
+        const int y = o.y + rand_y(rng_);
+        if (!dungeon.walkable(x, y)) continue;
+        if (std::abs(x - p.x) <= kSpawnDistance &&
+            std::abs(y - p.y) <= kSpawnDistance) {
+          continue;
+        }
+
+        spawn(static_cast<Kind>(k), (x + 0.5) * Config::kTileSize,
+              (y + 0.5) * Config::kTileSize);
+        break;
+      }
+    }
+  }
+}
+
+void Enemies::think(Group& g, const Type& type, const Dungeon& dungeon,
+                    const Player& player, unsigned int elapsed) {
+  std::uniform_int_distribution<int> rand_choice(0, 4);
+  for (int i = 0; i < g.count; ++i) {
+    if (g.state[i] == State::Dying) continue;
+    g.think[i] -= elapsed;
+    if (g.think[i] > 0) continue;
+    g.think[i] = type.think_time;
+
+    const double dx = player.x() - g.x[i];
+    const double dy = player.y() - g.y[i];
+    const auto p = dungeon.grid_coords(g.x[i], g.y[i]);
+    if (player.alive() && std::max(std::abs(dx), std::abs(dy)) < type.sight &&
+        field_.reaches(p.x, p.y)) {
+      g.state[i] = State::Chasing;
+      continue;
+    }
+
+    // One chance in five of standing still for a while.
+    const int choice = rand_choice(g.rng[i]);
+    if (choice == 4) {
+      g.state[i] = State::Waiting;
+    } else {
+      g.facing[i] = static_cast<Entity::Direction>(choice);
+      g.state[i] = State::Walking;
+    }
+  }
+}
+
+void Enemies::move(Group& g, const Type& type, const Dungeon& dungeon,
+                   const Player& player, unsigned int elapsed) {
+  for (int i = 0; i < g.count; ++i) {
+    if (g.state[i] == State::Dying) continue;
+    g.iframes[i] = std::max(0, g.iframes[i] - (int)elapsed);
+
+    Entity::Direction direction = g.facing[i];
+    double distance = 0;
+    if (g.kbtimer[i] > 0) {
+      const int time = std::min(g.kbtimer[i], (int)elapsed);
+      direction = g.knockback[i];
+      distance = Entity::kKnockbackSpeed * time;
+      g.kbtimer[i] -= time;
+    } else if (g.state[i] == State::Walking) {
+      distance = type.speed * elapsed;
+      g.timer[i] = (g.timer[i] + elapsed) % (2 * kAnimationTime);
+    } else if (g.state[i] == State::Chasing) {
+      distance = type.speed * elapsed;
+      g.timer[i] = (g.timer[i] + elapsed) % (2 * kAnimationTime);
+      chase(dungeon, player, g.x[i], g.y[i], direction, distance);
+      g.facing[i] = direction;
+    } else {
+      continue;
+    }
+
+    const auto d = Entity::delta_direction(direction, distance);
+    const auto b = box_at(g.x[i], g.y[i], kExtent);
+    if (d.first != 0) g.x[i] += dungeon.sweep_x(b, d.first);
+    if (d.second != 0) g.y[i] += dungeon.sweep_y(b, d.second);
+  }
+}
+
+// Follows the flow field from cell to cell, lining up with the middle of
+// each cell across the way it is going first so as not to catch on corners.
+// In the player's own cell it heads straight for them.
+void Enemies::chase(const Dungeon& dungeon, const Player& player, double x,
+                    double y, Entity::Direction& direction,
+                    double& distance) const {
+  const auto p = dungeon.grid_coords(x, y);
+  if (!field_.direction(p.x, p.y, direction)) {
+    const double dx = player.x() - x, dy = player.y() - y;
+    direction = Entity::reverse_direction(Entity::away_from(dx, dy));
+    distance = std::min(distance, std::max(std::abs(dx), std::abs(dy)));
+    return;
+  }
+
+  const double mx = (p.x + 0.5) * Config::kTileSize - x;
+  const double my = (p.y + 0.5) * Config::kTileSize - y;
+  const bool vertical = direction == Entity::Direction::North ||
+                        direction == Entity::Direction::South;
+  if (vertical && std::abs(mx) > kLineUp) {
+    direction = mx > 0 ? Entity::Direction::East : Entity::Direction::West;
+    distance = std::min(distance, std::abs(mx));
+  } else if (!vertical && std::abs(my) > kLineUp) {
+    direction = my > 0 ? Entity::Direction::South : Entity::Direction::North;
+    distance = std::min(distance, std::abs(my));
+  }
+}
+
+// A hash still shared with a copy is left to it, as whatever it holds is
+// about to be thrown away here.
+void Enemies::index() {
+  if (hash_.use_count() > 1) {
+    hash_ = std::make_shared<SpatialHash>(kKindCount * kCapacity);
+  }
+  hash_->clear();
+  for (int k = 0; k < kKindCount; ++k) {
+    const Group& g = *groups_[k];
+    for (int i = 0; i < g.count; ++i) {
+      if (g.state[i] == State::Dying) continue;
+      hash_->add(k * kCapacity + i,
+                {g.x[i] - kExtent, g.y[i] - kExtent, g.x[i] + kExtent,
+                 g.y[i] + kExtent});
+    }
+  }
+  hash_->build();
+}
+
+void Enemies::fight(Player& player) {
+  const Rect attack = player.attack_box();
+  if (attack.height() != 0) {
+    hash_->query(attack, [this, &player](int id) {
+      Group& g = group(id / kCapacity);
+      const int i = id % kCapacity;
+      if (g.iframes[i] > 0) return;
+
+      g.hp[i] -= player.damage();
+      if (g.hp[i] <= 0) {
+        g.state[i] = State::Dying;
+        g.timer[i] = 0;
+        return;
+      }
+      g.iframes[i] = Entity::kIFrameTime;
+      g.kbtimer[i] = Entity::kKnockbackTime;
+      g.knockback[i] =
+          Entity::away_from(player.x() - g.x[i], player.y() - g.y[i]);
+    });
+  }
+
+  hash_->query(player.hit_box(), [this, &player](int id) {
+    const Group& g = *groups_[id / kCapacity];
+    const int i = id % kCapacity;
+    if (g.state[i] == State::Dying) return;
+    player.hit(kTypes[id / kCapacity].damage, g.x[i], g.y[i]);
+  });
+}
+
+// Takes out enemies that have finished dying, and any left inside rooms
+// that endless dungeons have since walled up.
+void Enemies::bury(Group& g, const Dungeon& dungeon, unsigned int elapsed) {
+  for (int i = 0; i < g.count;) {
+    bool gone = false;
+    if (g.state[i] == State::Dying) {
+      g.timer[i] += elapsed;
+      gone = g.timer[i] > Entity::kDeathTime;
+    } else {
+      const auto p = dungeon.grid_coords(g.x[i], g.y[i]);
+      gone = !dungeon.walkable(p.x, p.y);
+    }
+
+    if (gone) {
+      remove(g, i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void Enemies::remove(Group& g, int i) {
+  const int last = --g.count;
+  g.x[i] = g.x[last];
+  g.y[i] = g.y[last];
+  g.facing[i] = g.facing[last];
+  g.knockback[i] = g.knockback[last];
+  g.state[i] = g.state[last];
+  g.hp[i] = g.hp[last];
+  g.timer[i] = g.timer[last];
+  g.think[i] = g.think[last];
+  g.iframes[i] = g.iframes[last];
+  g.kbtimer[i] = g.kbtimer[last];
+  g.rng[i] = g.rng[last];
+}
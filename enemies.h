@@ -0,0 +1,170 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "config.h"
+#include "dungeon.h"
+#include "entity.h"
+#include "flow_field.h"
+#include "player.h"
+#include "rect.h"
+#include "render_queue.h"
+#include "spatial_hash.h"
+#include "spritemap.h"
+
+// Every enemy in a dungeon.  Rather than an object each, enemies of a kind
+// share one set of arrays, a field to an array, so thinking, moving and
+// drawing run through one kind at a time over tightly packed data.
+//
+// Each kind has a fixed pool allocated up front, so spawning never
+// allocates.  Living enemies are kept at the front of their pool and the
+// last one fills the gap when one is removed.  Copies share pools until
+// one of them changes, so a copy costs little more than a pointer a kind.
+//
+// Every enemy has its own random numbers, seeded from the dungeon's seed and
+// how many enemies came before it, so what one does never depends on how
+// many others there are or what order they are kept in.  They are made the
+// way std::minstd_rand makes them, but kept where they can be saved.
+class Enemies {
+ public:
+  enum class Kind : std::uint8_t { Slime, Bat };
+  static constexpr int kKindCount = 2;
+  // Most enemies of any one kind at a time.
+  static constexpr int kCapacity = 256;
+  // Most bytes that save can write.
+  static constexpr size_t kMaxSaveSize =
+      15 + kKindCount * (5 + kCapacity * 49);
+
+  explicit Enemies(unsigned int seed);
+
+  void seed(unsigned int seed);
+  void clear();
+  // Returns false if there is no room left in the pool.
+  bool spawn(Kind kind, double x, double y);
+
+  // Fills each room with enemies the first time the player steps into it,
+  // then has every enemy think, move and fight the player.
+  void update(const Dungeon& dungeon, Player& player, unsigned int elapsed);
+  // Only enemies inside the queue's view are drawn.
+  void draw(RenderQueue& queue, int xo, int yo) const;
+
+  int count() const;
+  int count(Kind kind) const {
+    return groups_[static_cast<int>(kind)]->count;
+  }
+
+  // Where an enemy is and how healthy, by its place in its kind's pool,
+  // for tools and tests.
+  double x(Kind kind, int i) const {
+    return groups_[static_cast<int>(kind)]->x[i];
+  }
+  double y(Kind kind, int i) const {
+    return groups_[static_cast<int>(kind)]->y[i];
+  }
+  int health(Kind kind, int i) const {
+    return groups_[static_cast<int>(kind)]->hp[i];
+  }
+
+  std::uint64_t checksum() const;
+
+  // Everything but the seed, which the enemies of a restored run are made
+  // with.  Load returns false and leaves the enemies as they were if what
+  // it is given doesn't make sense.
+  void save(std::string& out) const;
+  bool load(const std::string& in, size_t& pos);
+
+ private:
+  enum class State : std::uint8_t { Waiting, Walking, Chasing, Dying };
+
+  static constexpr int kAnimationTime = 200;
+  // Pixels either side of the middle of an enemy that it collides with.
+  static constexpr double kExtent = Config::kHalfTile - 1;
+  // How far off the middle of a cell an enemy can be and still fit past
+  // the cells either side of it.
+  static constexpr double kLineUp = 0.5;
+  // Cells around the player that new enemies keep clear of.
+  static constexpr int kSpawnDistance = 3;
+  static constexpr int kSpawnTries = 10;
+  // Rooms past this one get no more enemies than it does.
+  static constexpr int kCrowdedRoom = 15;
+
+  // What every enemy of a kind has in common.
+  struct Type {
+    int sprite, hp, damage;
+    // Pixels per millisecond.
+    double speed;
+    // Milliseconds between changes of mind.
+    int think_time;
+    // How close the player has to be for the enemy to give chase, in
+    // pixels, as long as it has a way to them.  Kinds with none just
+    // wander.
+    double sight;
+  };
+  static const std::array<Type, kKindCount> kTypes;
+
+  // Numbers from 1 to 2^31 - 2, the same as std::minstd_rand.
+  struct Random {
+    using result_type = std::uint32_t;
+    static constexpr result_type min() { return 1; }
+    static constexpr result_type max() { return kModulus - 1; }
+
+    static constexpr std::uint32_t kModulus = 2147483647;
+    std::uint32_t state;
+
+    void seed(std::uint32_t seed) {
+      state = seed % kModulus;
+      if (state == 0) state = 1;
+    }
+    result_type operator()() {
+      state = static_cast<std::uint32_t>(std::uint64_t(state) * 48271 %
+                                         kModulus);
+      return state;
+    }
+  };
+
+  template <typename T>
+  using Pool = std::array<T, kCapacity>;
+
+  struct Group {
+    int count;
+    Pool<double> x, y;
+    Pool<Entity::Direction> facing, knockback;
+    Pool<State> state;
+    Pool<int> hp, timer, think, iframes, kbtimer;
+    Pool<Random> rng;
+  };
+
+  std::shared_ptr<const SpriteMap> sprites_;
+  unsigned int seed_;
+  // For picking where enemies go when a room is filled.
+  Random rng_;
+  std::array<std::shared_ptr<Group>, kKindCount> groups_;
+  // Where the living enemies were after they last moved.  Ids are the kind
+  // times kCapacity plus the place in the pool.  It is only read during
+  // update, after being rebuilt, so copies can share it until then.
+  std::shared_ptr<SpatialHash> hash_;
+  // Ways to the player through the room they are in.
+  FlowField field_;
+  // The highest numbered room that has been filled.
+  int deepest_;
+  // Enemies spawned so far, which picks each one's random numbers.
+  unsigned int spawned_;
+
+  // Unshares a kind's pool, for changing it.
+  Group& group(int kind);
+
+  void populate(const Dungeon& dungeon, const Player& player);
+  void think(Group& g, const Type& type, const Dungeon& dungeon,
+             const Player& player, unsigned int elapsed);
+  void move(Group& g, const Type& type, const Dungeon& dungeon,
+            const Player& player, unsigned int elapsed);
+  void chase(const Dungeon& dungeon, const Player& player, double x,
+             double y, Entity::Direction& direction, double& distance) const;
+  void index();
+  void fight(Player& player);
+  void bury(Group& g, const Dungeon& dungeon, unsigned int elapsed);
+  void remove(Group& g, int i);
+};
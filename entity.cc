@@ -1,8 +1,9 @@
 #include "entity.h"
 
-#include <random>
+#include <algorithm>
+#include <cmath>
 
-#include "util.h"
+#include "hash.h"
 
 Entity::Direction Entity::reverse_direction(Direction d) {
   switch (d) {
@@ -35,8 +36,16 @@ std::pair<double, double> Entity::delta_direction(Direction d, double amount) {
   return {0, 0};
 }
 
-Entity::Entity(std::string sprites, int cols, double x, double y, int hp)
-    : sprites_(sprites, cols, Config::kTileSize, Config::kTileSize),
+Entity::Direction Entity::away_from(double dx, double dy) {
+  if (std::abs(dy) > std::abs(dx)) {
+    return dy > 0 ? Direction::North : Direction::South;
+  } else {
+    return dx > 0 ? Direction::West : Direction::East;
+  }
+}
+
+Entity::Entity(const Prototype& prototype, double x, double y)
+    : sprites_(prototype.sprites),
       x_(x),
       y_(y),
       facing_(Direction::North),
@@ -45,10 +54,9 @@ Entity::Entity(std::string sprites, int cols, double x, double y, int hp)
       timer_(0),
       iframes_(0),
       kbtimer_(0),
-      maxhp_(hp),
+      maxhp_(prototype.hp),
       curhp_(maxhp_),
-      dead_(false),
-      rd_(Util::random_seed()) {}
+      dead_(false) {}
 
 double Entity::x() const { return x_; }
 
@@ -72,7 +80,7 @@ void Entity::update_generic(const Dungeon& dungeon, unsigned int elapsed) {
   }
 }
 
-void Entity::update(Dungeon& dungeon, unsigned int elapsed, Audio&) {
+void Entity::update(Dungeon& dungeon, unsigned int elapsed) {
   update_generic(dungeon, elapsed);
   timer_ += elapsed;
   if (state_ == State::Dying) {
@@ -83,23 +91,27 @@ void Entity::update(Dungeon& dungeon, unsigned int elapsed, Audio&) {
   }
 }
 
-void Entity::draw(Graphics& graphics, int xo, int yo) const {
+void Entity::draw(RenderQueue& queue, int xo, int yo) const {
   if (iframes_ > 0 && (iframes_ / 32) % 2 == 0) return;
 
   const int x = (int)x_ - Config::kHalfTile - xo;
   const int y = (int)y_ - Config::kHalfTile - yo;
 
+  queue.set_layer(RenderQueue::Layer::Entities);
   if (state_ == State::Dying) {
     int n = timer_ / kDeathFrame;
     if (n > 2) n = 4 - n;
-    sprites_.draw(graphics, n + 8, x, y);
+    queue.draw(*sprites_, n + 8, x, y);
   } else {
-    sprites_.draw_flip(graphics, sprite_number(), x, y,
-                       facing_ == Direction::West, false);
+    queue.draw_flip(*sprites_, sprite_number(), x, y,
+                    facing_ == Direction::West, false);
   }
 
 #ifndef NDEBUG
-  hit_box().draw(graphics, 0xffffff80, false, xo, yo);
+  queue.flush();
+  if (queue.has_graphics()) {
+    hit_box().draw(queue.graphics(), 0xffffff80, false, xo, yo);
+  }
 #endif
 }
 
@@ -108,20 +120,16 @@ bool Entity::dead() const { return dead_; }
 bool Entity::alive() const { return !dead_ && state_ != State::Dying; }
 
 void Entity::hit(Entity& source) {
+  hit(source.damage(), source.x(), source.y());
+}
+
+void Entity::hit(int damage, double x, double y) {
   if (curhp_ == 0 || iframes_ > 0) return;
 
-  hurt(source.damage());
+  hurt(damage);
   if (!alive()) return;
 
-  const double dx = source.x() - x_;
-  const double dy = source.y() - y_;
-
-  if (std::abs(dy) > std::abs(dx)) {
-    knockback_ = dy > 0 ? Direction::North : Direction::South;
-  } else {
-    knockback_ = dx > 0 ? Direction::West : Direction::East;
-  }
-
+  knockback_ = away_from(x - x_, y - y_);
   kbtimer_ = kKnockbackTime;
 }
 
@@ -151,17 +159,31 @@ Rect Entity::attack_box() const { return collision_box(); }
 
 Rect Entity::defense_box() const { return {0, 0, 0, 0}; }
 
-bool Entity::move_if_possible(const Dungeon& dungeon, double dx, double dy) {
-  x_ += dx;
-  y_ += dy;
-  if (!collision(dungeon)) return true;
-  x_ -= dx;
-  y_ -= dy;
-  return false;
+std::uint64_t Entity::checksum() const {
+  std::uint64_t hash = kHashBasis;
+  hash = hash_value(hash, x_);
+  hash = hash_value(hash, y_);
+  hash = hash_value(hash, facing_);
+  hash = hash_value(hash, knockback_);
+  hash = hash_value(hash, state_);
+  hash = hash_value(hash, timer_);
+  hash = hash_value(hash, iframes_);
+  hash = hash_value(hash, kbtimer_);
+  hash = hash_value(hash, curhp_);
+  return hash;
 }
 
-bool Entity::collision(const Dungeon& dungeon) const {
-  return !dungeon.box_walkable(collision_box());
+// Moves along each axis in turn so that being blocked on one still lets the
+// entity slide along the other.
+bool Entity::move_if_possible(const Dungeon& dungeon, double dx, double dy) {
+  const double x = x_, y = y_;
+
+  const Rect a = collision_box();
+  x_ += dungeon.sweep_x({a.left, a.top, a.right, a.bottom}, dx);
+  const Rect b = collision_box();
+  y_ += dungeon.sweep_y({b.left, b.top, b.right, b.bottom}, dy);
+
+  return x_ != x || y_ != y;
 }
 
 void Entity::state_transition(State state) {
@@ -1,10 +1,13 @@
 #pragma once
 
-#include <string>
+#include <cstdint>
+#include <memory>
+#include <utility>
 
 #include "config.h"
 #include "dungeon.h"
 #include "graphics.h"
+#include "render_queue.h"
 #include "rect.h"
 #include "spritemap.h"
 
@@ -12,10 +15,25 @@ class Entity {
  public:
   enum class Direction { North, East, South, West };
 
+  static constexpr int kDeathFrame = 50;
+  static constexpr int kDeathTime = kDeathFrame * 5;
+  static constexpr int kIFrameTime = 500;
+  static constexpr int kKnockbackTime = kIFrameTime / 2;
+  static constexpr double kKnockbackSpeed = 0.1;
+
   static Direction reverse_direction(Direction d);
   static std::pair<double, double> delta_direction(Direction d, double amount);
+  // Which way to go to get away from something at the given offset.
+  static Direction away_from(double dx, double dy);
+
+  // What every entity of a kind shares, made once and reused by each one
+  // spawned, so that spawning doesn't need to look anything up.
+  struct Prototype {
+    std::shared_ptr<const SpriteMap> sprites;
+    int hp;
+  };
 
-  Entity(std::string sprites, int cols, double x, double y, int hp);
+  Entity(const Prototype& prototype, double x, double y);
   virtual ~Entity() {}
 
   double x() const;
@@ -23,12 +41,15 @@ class Entity {
   void set_position(double x, double y);
 
   virtual void ai(const Dungeon& dungeon, const Entity& target);
-  virtual void update(Dungeon& dungeon, unsigned int elapsed, Audio&);
-  virtual void draw(Graphics& graphics, int xo, int yo) const;
+  virtual void update(Dungeon& dungeon, unsigned int elapsed);
+  virtual void draw(RenderQueue& queue, int xo, int yo) const;
   virtual bool dead() const;
   virtual bool alive() const;
 
-  virtual void hit(Entity& source);
+  void hit(Entity& source);
+  // Takes damage from something at the given position and is knocked away
+  // from it, unless still recovering from the last hit.
+  virtual void hit(int damage, double x, double y);
   void heal(int hp);
   void hurt(int hp);
   int max_health() const { return maxhp_; }
@@ -41,27 +62,24 @@ class Entity {
   virtual Rect attack_box() const;
   virtual Rect defense_box() const;
 
- protected:
-  static constexpr int kDeathFrame = 50;
-  static constexpr int kDeathTime = kDeathFrame * 5;
-  static constexpr int kIFrameTime = 500;
-  static constexpr int kKnockbackTime = kIFrameTime / 2;
-  static constexpr double kKnockbackSpeed = 0.1;
+  // Hash of all state that changes during play, for spotting desyncs.
+  virtual std::uint64_t checksum() const;
 
+ protected:
   enum class State { Waiting, Walking, Attacking, Holding, Retreating, Dying };
 
-  SpriteMap sprites_;
+  std::shared_ptr<const SpriteMap> sprites_;
   double x_, y_;
   Direction facing_, knockback_;
   State state_;
   int timer_, iframes_, kbtimer_;
   int maxhp_, curhp_;
   bool dead_;
-  std::default_random_engine rd_;
 
   virtual int sprite_number() const;
-  virtual bool collision(const Dungeon& dungeon) const;
 
+  // Moves as far towards the offset as the dungeon allows.  Returns whether
+  // the entity moved at all.
   bool move_if_possible(const Dungeon& dungeon, double dx, double dy);
   void state_transition(State state);
   void update_generic(const Dungeon& dungeon, unsigned int elapsed);
@@ -0,0 +1,75 @@
+#include "flow_field.h"
+
+FlowField::FlowField()
+    : origin_({0, 0}),
+      target_({-1, -1}),
+      revision_(0),
+      searches_(0),
+      distance_() {
+  distance_.fill(kUnreached);
+}
+
+void FlowField::update(const Dungeon& dungeon, Dungeon::Position target) {
+  if (target.x == target_.x && target.y == target_.y &&
+      dungeon.layout_revision() == revision_) {
+    return;
+  }
+
+  target_ = target;
+  revision_ = dungeon.layout_revision();
+
+  // Doorways are in the walls shared by two rooms, and belong to neither,
+  // so the field stays on whichever room it was already on.
+  const auto cell = dungeon.get_cell(target.x, target.y);
+  if (!cell.is_door() || !inside(target.x, target.y)) {
+    origin_ = dungeon.room_origin(cell.room);
+  }
+
+  search(dungeon);
+}
+
+bool FlowField::reaches(int x, int y) const {
+  return distance(x, y) != kUnreached;
+}
+
+bool FlowField::direction(int x, int y, Entity::Direction& d) const {
+  const std::uint8_t here = distance(x, y);
+  if (here == kUnreached || here == 0) return false;
+
+  if (distance(x, y - 1) < here) {
+    d = Entity::Direction::North;
+  } else if (distance(x + 1, y) < here) {
+    d = Entity::Direction::East;
+  } else if (distance(x, y + 1) < here) {
+    d = Entity::Direction::South;
+  } else {
+    d = Entity::Direction::West;
+  }
+  return true;
+}
+
+void FlowField::search(const Dungeon& dungeon) {
+  ++searches_;
+  distance_.fill(kUnreached);
+  if (!inside(target_.x, target_.y)) return;
+  if (!dungeon.walkable(target_.x, target_.y)) return;
+
+  std::array<Dungeon::Position, kWidth * kHeight> queue;
+  int head = 0, tail = 0;
+  queue[tail++] = target_;
+  distance_[index(target_.x, target_.y)] = 0;
+
+  static constexpr Dungeon::Position kSteps[] = {
+      {0, -1}, {1, 0}, {0, 1}, {-1, 0}};
+  while (head < tail) {
+    const auto p = queue[head++];
+    const std::uint8_t next = distance_[index(p.x, p.y)] + 1;
+    for (const auto& step : kSteps) {
+      const int x = p.x + step.x, y = p.y + step.y;
+      if (!inside(x, y) || distance_[index(x, y)] != kUnreached) continue;
+      if (!dungeon.walkable(x, y)) continue;
+      distance_[index(x, y)] = next;
+      queue[tail++] = {x, y};
+    }
+  }
+}
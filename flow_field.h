@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "dungeon.h"
+#include "entity.h"
+#include "room_templates.h"
+
+// Distances to a target tile from every cell of the room it is in, walls
+// and doorways included, found with a breadth first search over the cells
+// that can be walked on.  Anything in the room can then find its way to the
+// target by stepping to a neighbour that is closer.
+//
+// The search only runs again when the target moves to another tile or the
+// dungeon's layout changes, so it costs nothing on most ticks however many
+// things follow it.
+class FlowField {
+ public:
+  static constexpr int kWidth = RoomTemplates::kWidth + 2;
+  static constexpr int kHeight = RoomTemplates::kHeight + 2;
+
+  FlowField();
+
+  void update(const Dungeon& dungeon, Dungeon::Position target);
+
+  // Whether the target can be reached from a cell.
+  bool reaches(int x, int y) const;
+  // The way to step from a cell to get closer to the target.  Returns false
+  // if the cell is the target or the target can't be reached from it.
+  bool direction(int x, int y, Entity::Direction& d) const;
+
+  // Times the search has run, for seeing how well the cache works.
+  int searches() const { return searches_; }
+
+ private:
+  static constexpr std::uint8_t kUnreached = 0xff;
+
+  Dungeon::Position origin_, target_;
+  unsigned int revision_;
+  int searches_;
+  std::array<std::uint8_t, kWidth * kHeight> distance_;
+
+  bool inside(int x, int y) const {
+    return x >= origin_.x && x < origin_.x + kWidth && y >= origin_.y &&
+           y < origin_.y + kHeight;
+  }
+  int index(int x, int y) const {
+    return (y - origin_.y) * kWidth + x - origin_.x;
+  }
+  std::uint8_t distance(int x, int y) const {
+    return inside(x, y) ? distance_[index(x, y)] : kUnreached;
+  }
+  void search(const Dungeon& dungeon);
+};
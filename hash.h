@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// FNV-1a, used for state checksums that have to agree between builds.
+constexpr std::uint64_t kHashBasis = 14695981039346656037ull;
+
+inline std::uint64_t hash_bytes(std::uint64_t hash, const void* data,
+                                size_t size) {
+  const auto* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+template <typename T>
+std::uint64_t hash_value(std::uint64_t hash, const T& value) {
+  return hash_bytes(hash, &value, sizeof(value));
+}
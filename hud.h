@@ -1,15 +1,19 @@
 #pragma once
 
+#include <memory>
+#include <string>
+
 #include "dungeon.h"
 #include "graphics.h"
 #include "player.h"
+#include "render_queue.h"
 #include "spritemap.h"
 #include "text.h"
 
 class HUD {
  public:
   HUD();
-  void draw(Graphics& graphics, const Player& player,
+  void draw(RenderQueue& queue, const Player& player,
             const Dungeon& dungeon) const;
 
  private:
@@ -23,11 +27,14 @@ class HUD {
   static constexpr int kPanelTextWide = kPanelX + Config::kHalfTile;
   static constexpr int kPanelTextNarrow = kPanelTextWide + Config::kQuarterTile;
 
-  SpriteMap ui_;
-  Text text_;
+  std::shared_ptr<const SpriteMap> ui_;
+  std::shared_ptr<const Text> text_;
+  // The room label, only formatted again when the room changes.
+  mutable int label_room_;
+  mutable std::string label_;
 
-  void draw_hearts(Graphics& graphics, int x, int y, int full, int total) const;
-  void draw_orb_count(Graphics& graphics, int x, int y, int count) const;
-  void draw_panel(Graphics& graphics, int x, int y) const;
-  void draw_panel_row(Graphics& graphics, int x, int y, int first) const;
+  void draw_hearts(RenderQueue& queue, int x, int y, int full, int total) const;
+  void draw_orb_count(RenderQueue& queue, int x, int y, int count) const;
+  void draw_panel(RenderQueue& queue, int x, int y) const;
+  void draw_panel_row(RenderQueue& queue, int x, int y, int first) const;
 };
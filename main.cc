@@ -1,5 +1,8 @@
+#include <cstdio>
+
 #include "config.h"
 #include "game.h"
+#include "room_templates.h"
 #include "title_screen.h"
 
 #ifdef __EMSCRIPTEN__
@@ -8,7 +11,14 @@
 void step(void* game) { static_cast<Game*>(game)->step(); }
 #endif
 
-int main(int, char**) {
+int main(int argc, char** argv) {
+  // Mods can bring their own rooms.txt to play with instead of the built in
+  // room templates.
+  if (argc > 1 && !RoomTemplates::load(argv[1])) {
+    std::fprintf(stderr, "Could not load room templates from %s\n", argv[1]);
+    return 1;
+  }
+
   Game game(kConfig);
   Screen* start = new TitleScreen();
 
@@ -1,11 +1,67 @@
 #include "player.h"
 
+#include <algorithm>
+
+#include "assets.h"
+#include "hash.h"
+#include "profiler.h"
+
+namespace {
+
+struct Prototype {
+  Entity::Prototype entity;
+  std::shared_ptr<const SpriteMap> weapons;
+};
+
+Prototype make_prototype() {
+  Prototype prototype;
+  prototype.entity.sprites = Assets::get().sprite_map(
+      "player.png", 4, Config::kTileSize, Config::kTileSize);
+  prototype.entity.hp = 3;
+  prototype.weapons = Assets::get().sprite_map(
+      "weapons.png", 2, Config::kTileSize, Config::kTileSize);
+  return prototype;
+}
+
+// Looked up the first time a player is made, so that resetting a run only
+// copies pointers.
+const Prototype& prototype() {
+  static const Prototype prototype = make_prototype();
+  return prototype;
+}
+
+}  // namespace
+
 Player::Player(int x, int y)
-    : Entity("player.png", 4, x, y, 3),
-      weapons_("weapons.png", 2, Config::kTileSize, Config::kTileSize),
-      text_("text.png"),
+    : Entity(prototype().entity, x, y),
+      weapons_(prototype().weapons),
       attack_cooldown_(0),
-      orbs_(0) {}
+      orbs_(0),
+      sounds_(0),
+      result_(Dungeon::Result::None) {}
+
+void Player::control(Dungeon& dungeon, unsigned int buttons) {
+  if (buttons & kLeft) {
+    move(Direction::West);
+  } else if (buttons & kRight) {
+    move(Direction::East);
+  } else if (buttons & kUp) {
+    move(Direction::North);
+  } else if (buttons & kDown) {
+    move(Direction::South);
+  } else {
+    stop();
+  }
+
+  if (buttons & kInteract) {
+    if (!interact(dungeon)) attack();
+  }
+
+  if (buttons & kFocus) {
+    play(Sound::Focus);
+    focus();
+  }
+}
 
 void Player::move(Player::Direction direction) {
   if (state_ == State::Attacking) return;
@@ -19,7 +75,7 @@ void Player::stop() {
   if (state_ == State::Walking) state_ = State::Waiting;
 }
 
-bool Player::interact(Dungeon& dungeon, Audio& audio) {
+bool Player::interact(Dungeon& dungeon) {
   if (state_ == State::Dying) return true;
 
   auto p = dungeon.grid_coords(x_, y_);
@@ -42,7 +98,7 @@ bool Player::interact(Dungeon& dungeon, Audio& audio) {
   if (cell.tile == Dungeon::Tile::DoorClosed) {
     if (orbs_ > 0) {
       dungeon.open_door(p.x, p.y);
-      audio.play_sample("unlock.wav");
+      play(Sound::Unlock);
       --orbs_;
       return true;
     }
@@ -56,18 +112,21 @@ void Player::focus() {
   state_transition(State::Holding);
 }
 
-void Player::activate(Dungeon& dungeon, Audio& audio) {
+void Player::activate(Dungeon& dungeon) {
   if (state_ == State::Dying) return;
   if (state_ == State::Attacking) return;
 
   auto p = dungeon.grid_coords(x_, y_);
-  auto result = dungeon.activate(p.x, p.y, audio);
+  auto result = dungeon.activate(p.x, p.y);
+  if (result != Dungeon::Result::None) result_ = result;
+  if (result != Dungeon::Result::None) play(Sound::Activate);
   switch (result) {
     case Dungeon::Result::Overload:
-      audio.play_sample("hit.wav");
+      play(Sound::Hit);
       hurt(1);
       break;
     case Dungeon::Result::Perfect:
+      play(Sound::Orb);
       ++orbs_;
       break;
     default:
@@ -100,9 +159,14 @@ std::pair<double, double> grid_walk(double delta, double minor, int grid) {
   }
 }
 
-void Player::hit(Entity& source) { Entity::hit(source); }
+void Player::hit(int damage, double x, double y) {
+  if (curhp_ == 0 || iframes_ > 0) return;
+  play(Sound::Hit);
+  Entity::hit(damage, x, y);
+}
 
-void Player::update(Dungeon& dungeon, unsigned int elapsed, Audio& audio) {
+void Player::update(Dungeon& dungeon, unsigned int elapsed) {
+  PROFILE_ZONE("Player::update");
   Entity::update_generic(dungeon, elapsed);
 
   if (attack_cooldown_ > 0) attack_cooldown_ -= elapsed;
@@ -145,25 +209,65 @@ void Player::update(Dungeon& dungeon, unsigned int elapsed, Audio& audio) {
   } else if (state_ == State::Holding) {
     timer_ += elapsed;
     if (timer_ > kFocusTime) {
-      activate(dungeon, audio);
+      activate(dungeon);
       state_transition(State::Waiting);
     }
   }
 }
 
-void Player::draw(Graphics& graphics, int xo, int yo) const {
+void Player::restore(double x, double y, int hp, int orbs) {
+  set_position(x, y);
+  curhp_ = std::max(1, std::min(hp, maxhp_));
+  orbs_ = orbs;
+}
+
+Dungeon::Result Player::take_result() {
+  const Dungeon::Result result = result_;
+  result_ = Dungeon::Result::None;
+  return result;
+}
+
+unsigned int Player::take_sounds() {
+  const unsigned int sounds = sounds_;
+  sounds_ = 0;
+  return sounds;
+}
+
+const char* Player::sound_file(Sound sound) {
+  switch (sound) {
+    case Sound::Unlock:
+      return "unlock.wav";
+    case Sound::Activate:
+      return "activate.wav";
+    case Sound::Hit:
+      return "hit.wav";
+    case Sound::Orb:
+      return "orb.wav";
+    case Sound::Focus:
+      return "focus.wav";
+  }
+
+  return "";
+}
+
+void Player::play(Sound sound) { sounds_ |= 1u << static_cast<int>(sound); }
+
+void Player::draw(RenderQueue& queue, int xo, int yo) const {
   if (iframes_ > 0 && (iframes_ / 32) % 2 == 0) return;
 
   const int x = (int)x_ - Config::kHalfTile - xo;
   const int y = (int)y_ - Config::kHalfTile - yo;
 
-  if (facing_ == Direction::North) draw_weapon(graphics, xo, yo);
-  sprites_.draw_flip(graphics, sprite_number(), x, y,
-                     facing_ == Direction::West, false);
-  if (facing_ != Direction::North) draw_weapon(graphics, xo, yo);
+  queue.set_layer(RenderQueue::Layer::Entities);
+  queue.draw_flip(*sprites_, sprite_number(), x, y, facing_ == Direction::West,
+                  false);
+  draw_weapon(queue, xo, yo);
 
 #ifndef NDEBUG
-  hit_box().draw(graphics, 0xff0000ff, false, xo, yo);
+  queue.flush();
+  if (queue.has_graphics()) {
+    hit_box().draw(queue.graphics(), 0xff0000ff, false, xo, yo);
+  }
 #endif
 }
 
@@ -237,7 +341,14 @@ Rect Player::attack_box() const {
   }
 }
 
-void Player::draw_weapon(Graphics& graphics, int xo, int yo) const {
+std::uint64_t Player::checksum() const {
+  std::uint64_t hash = Entity::checksum();
+  hash = hash_value(hash, attack_cooldown_);
+  hash = hash_value(hash, orbs_);
+  return hash;
+}
+
+void Player::draw_weapon(RenderQueue& queue, int xo, int yo) const {
   const Rect weapon = attack_box();
   int wx = (int)weapon.left - xo;
   int wy = (int)weapon.top - yo;
@@ -264,9 +375,15 @@ void Player::draw_weapon(Graphics& graphics, int xo, int yo) const {
     }
 
     // TODO better handling of weapon sprite positioning
-    weapons_.draw(graphics, weapon_sprite, wx, wy);
+    queue.set_layer(facing_ == Direction::North
+                        ? RenderQueue::Layer::BehindEntities
+                        : RenderQueue::Layer::InFront);
+    queue.draw(*weapons_, weapon_sprite, wx, wy);
 #ifndef NDEBUG
-    weapon.draw(graphics, 0x0000ffff, false, xo, yo);
+    queue.flush();
+    if (queue.has_graphics()) {
+      weapon.draw(queue.graphics(), 0x0000ffff, false, xo, yo);
+    }
 #endif
   }
 }
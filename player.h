@@ -3,29 +3,54 @@
 #include "config.h"
 #include "entity.h"
 #include "graphics.h"
+#include "render_queue.h"
 #include "rect.h"
 #include "spritemap.h"
-#include "text.h"
 
 class Player : public Entity {
  public:
+  // Directions are held, Interact and Focus are only pressed for one update.
+  enum Button : unsigned int {
+    kLeft = 1 << 0,
+    kRight = 1 << 1,
+    kUp = 1 << 2,
+    kDown = 1 << 3,
+    kInteract = 1 << 4,
+    kFocus = 1 << 5,
+  };
+
+  // Sounds are queued up rather than played so that the player can run
+  // without any audio.
+  enum class Sound { Unlock, Activate, Hit, Orb, Focus };
+  static constexpr int kSoundCount = 5;
+
   Player(int x, int y);
 
+  void control(Dungeon& dungeon, unsigned int buttons);
   void move(Direction direction);
   void stop();
-  bool interact(Dungeon& dungeon, Audio& audio);
+  bool interact(Dungeon& dungeon);
   void focus();
   void attack();
 
-  void hit(Entity& source) override;
-  void update(Dungeon& dungeon, unsigned int elapsed, Audio& audio) override;
-  void draw(Graphics& graphics, int xo, int yo) const override;
+  using Entity::hit;
+  void hit(int damage, double x, double y) override;
+  void update(Dungeon& dungeon, unsigned int elapsed) override;
+  void draw(RenderQueue& queue, int xo, int yo) const override;
 
   Rect collision_box() const override;
   Rect hit_box() const override;
   Rect attack_box() const override;
+  std::uint64_t checksum() const override;
 
   int orbs() const { return orbs_; }
+  // Puts back what a saved player had, where they were.
+  void restore(double x, double y, int hp, int orbs);
+  unsigned int take_sounds();
+  // What the last cell the player activated did, or None if there has been
+  // no activation since last asked.
+  Dungeon::Result take_result();
+  static const char* sound_file(Sound sound);
 
  private:
   static constexpr double kSpeed = 0.1;
@@ -36,11 +61,13 @@ class Player : public Entity {
   static constexpr int kSpinTime = kAnimationTime / 2;
   static constexpr int kFocusTime = 500;
 
-  SpriteMap weapons_;
-  Text text_;
+  std::shared_ptr<const SpriteMap> weapons_;
   int attack_cooldown_, orbs_;
+  unsigned int sounds_;
+  Dungeon::Result result_;
 
   int sprite_number() const override;
-  void draw_weapon(Graphics& graphics, int xo, int yo) const;
-  void activate(Dungeon& dungeon, Audio& audio);
+  void draw_weapon(RenderQueue& queue, int xo, int yo) const;
+  void activate(Dungeon& dungeon);
+  void play(Sound sound);
 };
@@ -0,0 +1,156 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+
+namespace {
+
+// Each slot carries the sequence number of the event in it, written last,
+// so a reader can tell a finished event from one being overwritten.
+struct Slot {
+  std::atomic<std::uint64_t> sequence;
+  std::atomic<int> zone, thread;
+  std::atomic<std::uint64_t> start, duration;
+};
+
+std::array<Slot, Profiler::kRingSize> ring;
+std::atomic<std::uint64_t> head(0);
+
+std::mutex zone_mutex;
+std::array<const char*, Profiler::kMaxZones> zone_names;
+std::atomic<int> zones(0);
+
+std::array<std::atomic<std::uint64_t>, Profiler::kCounterCount> totals;
+std::array<std::uint64_t, Profiler::kCounterCount> frame_start, last_frame;
+
+std::atomic<int> threads(0);
+
+const auto epoch = std::chrono::steady_clock::now();
+
+int thread_number() {
+  thread_local const int number = threads.fetch_add(1);
+  return number;
+}
+
+}  // namespace
+
+int Profiler::zone(const char* name) {
+  std::lock_guard<std::mutex> lock(zone_mutex);
+  const int count = zones.load(std::memory_order_relaxed);
+  for (int i = 0; i < count; ++i) {
+    if (zone_names[i] == name) return i;
+  }
+
+  // Zones past the limit are all counted as the last one.
+  if (count == kMaxZones) return kMaxZones - 1;
+  zone_names[count] = name;
+  zones.store(count + 1, std::memory_order_release);
+  return count;
+}
+
+const char* Profiler::zone_name(int zone) { return zone_names[zone]; }
+
+int Profiler::zone_count() {
+  return std::min(zones.load(std::memory_order_acquire), kMaxZones);
+}
+
+std::uint64_t Profiler::now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void Profiler::record(int zone, std::uint64_t start, std::uint64_t duration) {
+  const std::uint64_t n = head.fetch_add(1, std::memory_order_relaxed);
+  Slot& slot = ring[n % kRingSize];
+  slot.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.zone.store(zone, std::memory_order_relaxed);
+  slot.thread.store(thread_number(), std::memory_order_relaxed);
+  slot.start.store(start, std::memory_order_relaxed);
+  slot.duration.store(duration, std::memory_order_relaxed);
+  slot.sequence.store(n + 1, std::memory_order_release);
+}
+
+void Profiler::count(Counter counter, std::uint64_t amount) {
+  totals[static_cast<int>(counter)].fetch_add(amount,
+                                              std::memory_order_relaxed);
+}
+
+void Profiler::frame() {
+  for (int i = 0; i < kCounterCount; ++i) {
+    const std::uint64_t total = totals[i].load(std::memory_order_relaxed);
+    last_frame[i] = total - frame_start[i];
+    frame_start[i] = total;
+  }
+}
+
+std::uint64_t Profiler::frame_count(Counter counter) {
+  return last_frame[static_cast<int>(counter)];
+}
+
+int Profiler::snapshot(std::array<Event, kRingSize>& events) {
+  const std::uint64_t end = head.load(std::memory_order_acquire);
+  const std::uint64_t begin = end > kRingSize ? end - kRingSize : 0;
+
+  int count = 0;
+  for (std::uint64_t n = begin; n < end; ++n) {
+    const Slot& slot = ring[n % kRingSize];
+    if (slot.sequence.load(std::memory_order_acquire) != n + 1) continue;
+    const Event e = {slot.zone.load(std::memory_order_relaxed),
+                     slot.thread.load(std::memory_order_relaxed),
+                     slot.start.load(std::memory_order_relaxed),
+                     slot.duration.load(std::memory_order_relaxed)};
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != n + 1) continue;
+    events[count++] = e;
+  }
+  return count;
+}
+
+void Profiler::percentiles(std::array<Percentiles, kMaxZones>& out) {
+  static std::array<Event, kRingSize> events;
+  static std::array<std::uint64_t, kRingSize> times;
+
+  const int count = snapshot(events);
+  for (int zone = 0; zone < kMaxZones; ++zone) {
+    int samples = 0;
+    for (int i = 0; i < count; ++i) {
+      if (events[i].zone == zone) times[samples++] = events[i].duration;
+    }
+    if (samples == 0) {
+      out[zone] = {0, 0, 0};
+      continue;
+    }
+
+    auto* first = times.data();
+    auto* last = first + samples;
+    auto* p50 = first + samples / 2;
+    auto* p99 = first + samples * 99 / 100;
+    std::nth_element(first, p50, last);
+    const std::uint64_t median = *p50;
+    std::nth_element(first, p99, last);
+    out[zone] = {samples, median, *p99};
+  }
+}
+
+bool Profiler::write_trace(const std::string& file) {
+  static std::array<Event, kRingSize> events;
+  const int count = snapshot(events);
+
+  std::FILE* out = std::fopen(file.c_str(), "w");
+  if (!out) return false;
+
+  std::fprintf(out, "{\"traceEvents\":[");
+  for (int i = 0; i < count; ++i) {
+    const Event& e = events[i];
+    std::fprintf(out,
+                 "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                 "\"ts\":%.3f,\"dur\":%.3f}",
+                 i > 0 ? "," : "", zone_name(e.zone), e.thread,
+                 e.start / 1000.0, e.duration / 1000.0);
+  }
+  std::fprintf(out, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  return std::fclose(out) == 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Scoped timing zones and counters for finding where frame time goes.
+// Build with -DPROFILING to turn them on; otherwise the macros below
+// compile to nothing.
+//
+// Every zone that closes is written to a fixed ring of recent events.
+// Writers claim slots with a single atomic increment and never wait, so
+// zones can be timed from any thread.
+class Profiler {
+ public:
+  enum class Counter { CellsScanned, SpritesDrawn };
+  static constexpr int kCounterCount = 2;
+  static constexpr int kMaxZones = 32;
+  static constexpr std::uint32_t kRingSize = 1 << 14;
+
+  struct Event {
+    int zone;
+    int thread;
+    std::uint64_t start, duration;
+  };
+
+  struct Percentiles {
+    int samples;
+    std::uint64_t p50, p99;
+  };
+
+  class Scope {
+   public:
+    explicit Scope(int zone) : zone_(zone), start_(now()) {}
+    ~Scope() { record(zone_, start_, now() - start_); }
+
+   private:
+    int zone_;
+    std::uint64_t start_;
+  };
+
+  // Registers a zone and returns its id.  Names must outlive the profiler.
+  static int zone(const char* name);
+  static const char* zone_name(int zone);
+  static int zone_count();
+
+  static std::uint64_t now();
+  static void record(int zone, std::uint64_t start, std::uint64_t duration);
+  static void count(Counter counter, std::uint64_t amount);
+
+  // Marks the start of a frame, making the counters of the one just ended
+  // available from frame_count().
+  static void frame();
+  static std::uint64_t frame_count(Counter counter);
+
+  // Copies out the events still in the ring, oldest first, and returns how
+  // many there were.
+  static int snapshot(std::array<Event, kRingSize>& events);
+  // Times in nanoseconds of every zone, over the events still in the ring.
+  static void percentiles(std::array<Percentiles, kMaxZones>& zones);
+
+  // Writes the events still in the ring as Chrome trace JSON.
+  static bool write_trace(const std::string& file);
+};
+
+#ifdef PROFILING
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#define PROFILE_ZONE(name)                                           \
+  static const int PROFILE_CONCAT(profile_zone_id_, __LINE__) =      \
+      Profiler::zone(name);                                          \
+  const Profiler::Scope PROFILE_CONCAT(profile_zone_, __LINE__)(     \
+      PROFILE_CONCAT(profile_zone_id_, __LINE__))
+
+#define PROFILE_COUNT(counter, amount) \
+  Profiler::count(Profiler::Counter::counter, (amount))
+
+#else
+
+#define PROFILE_ZONE(name)
+#define PROFILE_COUNT(counter, amount)
+
+#endif
@@ -0,0 +1,82 @@
+#include "render_queue.h"
+
+#include <algorithm>
+#include <functional>
+
+#include "allocations.h"
+#include "profiler.h"
+
+RenderQueue::RenderQueue()
+    : graphics_(nullptr),
+      width_(0),
+      height_(0),
+      layer_(Layer::Floor),
+      last_submitted_(nullptr),
+      last_drawn_(nullptr),
+      stats_() {
+  commands_.reserve(kReserved);
+}
+
+void RenderQueue::begin(Graphics& graphics) {
+  begin(graphics.width(), graphics.height());
+  graphics_ = &graphics;
+}
+
+void RenderQueue::begin(int width, int height) {
+  graphics_ = nullptr;
+  width_ = width;
+  height_ = height;
+  layer_ = Layer::Floor;
+  commands_.clear();
+  last_submitted_ = nullptr;
+  last_drawn_ = nullptr;
+  stats_ = {};
+}
+
+void RenderQueue::draw(const SpriteMap& sprites, int n, int x, int y) {
+  draw_flip(sprites, n, x, y, false, false);
+}
+
+void RenderQueue::draw_flip(const SpriteMap& sprites, int n, int x, int y,
+                            bool hflip, bool vflip) {
+  if (&sprites != last_submitted_) {
+    if (last_submitted_) ++stats_.unsorted_switches;
+    last_submitted_ = &sprites;
+  }
+
+  const std::uint32_t sequence = commands_.size();
+  commands_.push_back({layer_, &sprites, sequence, n, x, y, hflip, vflip});
+}
+
+void RenderQueue::flush() {
+  if (commands_.empty()) return;
+
+  std::sort(commands_.begin(), commands_.end(),
+            [](const Command& a, const Command& b) {
+              if (a.layer != b.layer) return a.layer < b.layer;
+              if (a.sprites != b.sprites) {
+                return std::less<const SpriteMap*>()(a.sprites, b.sprites);
+              }
+              return a.sequence < b.sequence;
+            });
+
+  // Whatever gam does to draw a sprite is out of our hands.
+  Allocations::Exempt exempt;
+  for (const auto& c : commands_) {
+    if (c.sprites != last_drawn_) {
+      if (last_drawn_) ++stats_.switches;
+      last_drawn_ = c.sprites;
+    }
+    if (!graphics_) continue;
+    if (c.hflip || c.vflip) {
+      c.sprites->draw_flip(*graphics_, c.n, c.x, c.y, c.hflip, c.vflip);
+    } else {
+      c.sprites->draw(*graphics_, c.n, c.x, c.y);
+    }
+  }
+
+  PROFILE_COUNT(SpritesDrawn, commands_.size());
+  stats_.draws += commands_.size();
+  ++stats_.flushes;
+  commands_.clear();
+}
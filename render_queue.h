@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "graphics.h"
+#include "spritemap.h"
+
+// Collects sprite draws and issues them layer by layer, grouped by sprite
+// sheet so the renderer switches textures as rarely as possible.
+//
+// Draws in the same layer keep their order when they use the same sheet but
+// not otherwise, so sprites from different sheets that overlap need to be in
+// different layers.  Anything drawn straight to the graphics (text, rects,
+// single sprites) has to flush the queue first to keep its place.
+class RenderQueue {
+ public:
+  enum class Layer {
+    Floor,
+    Numbers,
+    DoorFrames,
+    BehindEntities,
+    Entities,
+    InFront,
+    Hud,
+  };
+
+  struct Stats {
+    int draws;
+    int flushes;
+    // Sheet changes as drawn, and as they would have been in the order the
+    // draws were submitted.
+    int switches;
+    int unsorted_switches;
+  };
+
+  RenderQueue();
+
+  // Starts a frame and resets the stats.
+  void begin(Graphics& graphics);
+  // Starts a frame with nothing to draw to.  Flushing still sorts and counts
+  // the draws but then drops them, which is handy for measuring.
+  void begin(int width, int height);
+
+  // Only frames begun with a Graphics have one, so anything drawing to it
+  // directly has to check first.
+  bool has_graphics() const { return graphics_ != nullptr; }
+  Graphics& graphics() const {
+    assert(graphics_);
+    return *graphics_;
+  }
+  int width() const { return width_; }
+  int height() const { return height_; }
+
+  void set_layer(Layer layer) { layer_ = layer; }
+  void draw(const SpriteMap& sprites, int n, int x, int y);
+  void draw_flip(const SpriteMap& sprites, int n, int x, int y, bool hflip,
+                 bool vflip);
+  void flush();
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  // Enough for a busy frame, so the queue does not grow while playing.
+  static constexpr int kReserved = 1024;
+
+  struct Command {
+    Layer layer;
+    const SpriteMap* sprites;
+    std::uint32_t sequence;
+    int n, x, y;
+    bool hflip, vflip;
+  };
+
+  Graphics* graphics_;
+  int width_, height_;
+  Layer layer_;
+  std::vector<Command> commands_;
+  const SpriteMap* last_submitted_;
+  const SpriteMap* last_drawn_;
+  Stats stats_;
+};
@@ -0,0 +1,99 @@
+#include "replay.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "allocations.h"
+#include "varint.h"
+
+constexpr char Replay::kMagic[4];
+
+Replay::Replay(unsigned int seed, Dungeon::Mode mode, bool enemies)
+    : seed_(seed), mode_(mode), enemies_(enemies) {
+  runs_.reserve(kReservedRuns);
+}
+
+unsigned long Replay::ticks() const {
+  unsigned long total = 0;
+  for (const auto& run : runs_) total += run.ticks;
+  return total;
+}
+
+void Replay::record(unsigned int buttons, unsigned int elapsed) {
+  if (!runs_.empty()) {
+    Run& last = runs_.back();
+    if (last.buttons == buttons && last.elapsed == elapsed) {
+      ++last.ticks;
+      return;
+    }
+  }
+  // Long runs outgrow the room kept for them, a doubling at a time.
+  if (runs_.size() == runs_.capacity()) {
+    Allocations::Exempt exempt;
+    runs_.reserve(2 * runs_.capacity());
+  }
+  runs_.push_back({1, buttons, elapsed});
+}
+
+bool Replay::save(const std::string& file) const {
+  std::string out(kMagic, sizeof(kMagic));
+  out.push_back(kVersion);
+  out.push_back(static_cast<char>(mode_));
+  out.push_back(enemies_ ? kEnemies : 0);
+  put_varint(out, seed_);
+  for (const auto& run : runs_) {
+    put_varint(out, run.ticks);
+    put_varint(out, run.buttons);
+    put_varint(out, run.elapsed);
+  }
+
+  std::ofstream writer(file, std::ios::binary);
+  writer.write(out.data(), out.size());
+  return writer.good();
+}
+
+bool Replay::load(const std::string& file) {
+  std::ifstream reader(file, std::ios::binary);
+  const std::string in((std::istreambuf_iterator<char>(reader)),
+                       std::istreambuf_iterator<char>());
+
+  if (in.size() <= sizeof(kMagic)) return false;
+  if (std::memcmp(in.data(), kMagic, sizeof(kMagic)) != 0) return false;
+  const std::uint8_t version = in[sizeof(kMagic)];
+  if (version < 1 || version > kVersion) return false;
+
+  size_t pos = sizeof(kMagic) + 1;
+  auto mode = Dungeon::Mode::Classic;
+  if (version >= 2) {
+    if (pos >= in.size()) return false;
+    mode = static_cast<Dungeon::Mode>(in[pos++]);
+    if (mode != Dungeon::Mode::Classic && mode != Dungeon::Mode::Endless) {
+      return false;
+    }
+  }
+
+  bool enemies = false;
+  if (version >= 3) {
+    if (pos >= in.size()) return false;
+    enemies = in[pos++] & kEnemies;
+  }
+
+  std::uint32_t seed;
+  if (!get_varint(in, pos, seed)) return false;
+
+  std::vector<Run> runs;
+  while (pos < in.size()) {
+    Run run;
+    if (!get_varint(in, pos, run.ticks)) return false;
+    if (!get_varint(in, pos, run.buttons)) return false;
+    if (!get_varint(in, pos, run.elapsed)) return false;
+    runs.push_back(run);
+  }
+
+  seed_ = seed;
+  mode_ = mode;
+  enemies_ = enemies;
+  runs_.swap(runs);
+  return true;
+}
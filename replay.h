@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dungeon.h"
+
+// A run stored as its seed, the kind of dungeon, whether it had enemies, and
+// the buttons and frame time of every update.  Consecutive updates with the
+// same buttons and frame time are stored as a single run, so a recording only
+// grows when the input or the frame rate changes.
+class Replay {
+ public:
+  struct Run {
+    std::uint32_t ticks;
+    std::uint32_t buttons;
+    std::uint32_t elapsed;
+  };
+
+  explicit Replay(unsigned int seed = 0,
+                  Dungeon::Mode mode = Dungeon::Mode::Classic,
+                  bool enemies = false);
+
+  unsigned int seed() const { return seed_; }
+  Dungeon::Mode mode() const { return mode_; }
+  bool enemies() const { return enemies_; }
+  const std::vector<Run>& runs() const { return runs_; }
+  unsigned long ticks() const;
+
+  // Runs go into room kept for them up front, which only grows once a
+  // recording outlasts it.
+  void record(unsigned int buttons, unsigned int elapsed);
+
+  bool save(const std::string& file) const;
+  bool load(const std::string& file);
+
+ private:
+  static constexpr char kMagic[4] = {'M', 'R', 'E', 'P'};
+  // Version 1 replays have no mode and are all classic.  Versions before 3
+  // have no options and no enemies.
+  static constexpr std::uint8_t kVersion = 3;
+  static constexpr std::uint8_t kEnemies = 1 << 0;
+  static constexpr size_t kReservedRuns = 4096;
+
+  unsigned int seed_;
+  Dungeon::Mode mode_;
+  bool enemies_;
+  std::vector<Run> runs_;
+};
@@ -0,0 +1,112 @@
+#include "room_templates.h"
+
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+using Template = RoomTemplates::Template;
+using Tile = Dungeon::Tile;
+
+constexpr char kRooms[] =
+#include "rooms.inc"
+    ;
+
+constexpr bool tile_for_char(char c, Tile& tile) {
+  switch (c) {
+    case '.':
+      tile = Tile::Room;
+      return true;
+    case 'x':
+      tile = Tile::Block;
+      return true;
+    case 'o':
+      tile = Tile::Pit;
+      return true;
+    case 's':
+      tile = Tile::Sand;
+      return true;
+    case 'l':
+      tile = Tile::StatueLeft;
+      return true;
+    case 'r':
+      tile = Tile::StatueRight;
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Reads the templates in some text into out, which can be null to only
+// count them.  Returns how many there are, or -1 if any line is the wrong
+// length, has an unknown cell or leaves a template short.
+constexpr int parse(const char* text, size_t size, Template* out) {
+  int count = 0, rows = 0;
+  size_t line = 0;
+  while (line < size) {
+    size_t end = line;
+    while (end < size && text[end] != '\n') ++end;
+    size_t length = end - line;
+    if (length > 0 && text[end - 1] == '\r') --length;
+
+    if (length == 0) {
+      if (rows != 0) return -1;
+    } else {
+      if (length != RoomTemplates::kWidth) return -1;
+      for (int x = 0; x < RoomTemplates::kWidth; ++x) {
+        Tile tile = Tile::Room;
+        if (!tile_for_char(text[line + x], tile)) return -1;
+        if (out) out[count][rows * RoomTemplates::kWidth + x] = tile;
+      }
+      if (++rows == RoomTemplates::kHeight) {
+        rows = 0;
+        ++count;
+      }
+    }
+    line = end + 1;
+  }
+  return rows == 0 ? count : -1;
+}
+
+constexpr int kBuiltInCount = parse(kRooms, sizeof(kRooms) - 1, nullptr);
+static_assert(kBuiltInCount >= 0,
+              "rooms.txt must be rows of 11 known cells, 7 to a template, "
+              "with blank lines between templates");
+// The first template is the entrance, and normal rooms draw from the rest.
+static_assert(kBuiltInCount > 1, "rooms.txt needs at least two templates");
+
+constexpr std::array<Template, kBuiltInCount> built_in() {
+  std::array<Template, kBuiltInCount> templates = {};
+  parse(kRooms, sizeof(kRooms) - 1, templates.data());
+  return templates;
+}
+
+constexpr std::array<Template, kBuiltInCount> kBuiltIn = built_in();
+
+const Template* templates = kBuiltIn.data();
+int template_count = kBuiltInCount;
+std::vector<Template> loaded;
+
+}  // namespace
+
+int RoomTemplates::count() { return template_count; }
+
+const RoomTemplates::Template& RoomTemplates::get(int n) {
+  return templates[n];
+}
+
+bool RoomTemplates::load(const std::string& file) {
+  std::ifstream reader(file);
+  if (!reader) return false;
+  const std::string text(std::istreambuf_iterator<char>(reader), {});
+
+  const int count = parse(text.data(), text.size(), nullptr);
+  if (count < 2) return false;
+
+  loaded.assign(count, {});
+  parse(text.data(), text.size(), loaded.data());
+  templates = loaded.data();
+  template_count = count;
+  return true;
+}
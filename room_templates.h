@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <string>
+
+#include "dungeon.h"
+
+// The layouts rooms are filled in with.  They are parsed out of
+// content/rooms.txt while compiling, so a malformed file fails the build
+// instead of the game.
+//
+// The file holds templates of 7 rows of 11 cells, separated by blank lines.
+// A cell is one of:
+//
+//   .  floor        x  block        o  pit        s  sand
+//   l  statue facing left           r  statue facing right
+class RoomTemplates {
+ public:
+  static constexpr int kWidth = 11;
+  static constexpr int kHeight = 7;
+  static constexpr int kSize = kWidth * kHeight;
+
+  using Template = std::array<Dungeon::Tile, kSize>;
+
+  static int count();
+  static const Template& get(int n);
+
+  // Swaps the built in templates for those in a file, for mods.  This has
+  // to happen before any dungeons are made.  Returns false and keeps the
+  // current templates if the file is missing or malformed.
+  static bool load(const std::string& file);
+};
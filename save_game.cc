@@ -0,0 +1,182 @@
+#include "save_game.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include "allocations.h"
+#include "varint.h"
+
+constexpr char SaveGame::kMagic[4];
+
+SaveGame::SaveGame()
+    : seed_(0),
+      dungeon_seed_(0),
+      mode_(Dungeon::Mode::Classic),
+      enemies_(false),
+      x_(0),
+      y_(0),
+      hp_(0),
+      orbs_(0) {}
+
+SaveGame::SaveGame(unsigned int seed, const Dungeon& dungeon,
+                   const Player& player, const Enemies* enemies)
+    : SaveGame() {
+  update(seed, dungeon, player, enemies);
+}
+
+// Classic dungeons move on to the next seed until one works, so it is the
+// seed that worked that makes the dungeon again, in one try.
+void SaveGame::update(unsigned int seed, const Dungeon& dungeon,
+                      const Player& player, const Enemies* enemies) {
+  // The journal grows for as long as the run goes on, and the save with it.
+  if (journal_.capacity() < dungeon.journal_size()) {
+    Allocations::Exempt exempt;
+    journal_.reserve(2 * dungeon.journal_size());
+  }
+  // Enough for the most enemies there can be, the first time.
+  if (enemies && enemy_state_.capacity() < Enemies::kMaxSaveSize) {
+    Allocations::Exempt exempt;
+    enemy_state_.reserve(Enemies::kMaxSaveSize);
+  }
+
+  seed_ = seed;
+  dungeon_seed_ = dungeon.seed();
+  mode_ = dungeon.mode();
+  enemies_ = enemies;
+  x_ = player.x();
+  y_ = player.y();
+  hp_ = player.health();
+  orbs_ = player.orbs();
+  enemy_state_.clear();
+  if (enemies) enemies->save(enemy_state_);
+  dungeon.journal(journal_);
+}
+
+Dungeon SaveGame::dungeon(int size) const {
+  Dungeon dungeon(size, size, dungeon_seed_, mode_);
+  dungeon.replay(journal_);
+  return dungeon;
+}
+
+void SaveGame::restore(Player& player) const {
+  player.restore(x_, y_, hp_, orbs_);
+}
+
+void SaveGame::restore(Enemies& enemies) const {
+  size_t pos = 0;
+  enemies.load(enemy_state_, pos);
+}
+
+void SaveGame::write(std::string& out) const {
+  // Room for the header, the enemies and the longest change.
+  const size_t size = 64 + enemy_state_.size() + 11 * journal_.size();
+  if (out.capacity() < size) {
+    Allocations::Exempt exempt;
+    out.reserve(2 * size);
+  }
+
+  out.assign(kMagic, sizeof(kMagic));
+  out.push_back(kVersion);
+  out.push_back(static_cast<char>(mode_));
+  out.push_back(enemies_ ? kEnemies : 0);
+  put_varint(out, seed_);
+  put_varint(out, dungeon_seed_);
+  put_double(out, x_);
+  put_double(out, y_);
+  put_varint(out, hp_);
+  put_varint(out, orbs_);
+  if (enemies_) {
+    put_varint(out, enemy_state_.size());
+    out.append(enemy_state_);
+  }
+  for (const auto& change : journal_) {
+    out.push_back(static_cast<char>(change.kind));
+    put_varint(out, change.position.x);
+    put_varint(out, change.position.y);
+  }
+}
+
+bool SaveGame::save(const std::string& file) const {
+  std::string data;
+  write(data);
+  return write_file(file, data);
+}
+
+bool SaveGame::load(const std::string& file) {
+  std::ifstream reader(file, std::ios::binary);
+  const std::string in((std::istreambuf_iterator<char>(reader)),
+                       std::istreambuf_iterator<char>());
+
+  if (in.size() <= sizeof(kMagic) + 1) return false;
+  if (std::memcmp(in.data(), kMagic, sizeof(kMagic)) != 0) return false;
+  if (in[sizeof(kMagic)] != kVersion) return false;
+
+  size_t pos = sizeof(kMagic) + 1;
+  const auto mode = static_cast<Dungeon::Mode>(in[pos++]);
+  if (mode != Dungeon::Mode::Classic && mode != Dungeon::Mode::Endless) {
+    return false;
+  }
+  if (pos >= in.size()) return false;
+  const bool enemies = in[pos++] & kEnemies;
+
+  std::uint32_t seed, dungeon_seed, hp, orbs;
+  double x, y;
+  if (!get_varint(in, pos, seed)) return false;
+  if (!get_varint(in, pos, dungeon_seed)) return false;
+  if (!get_double(in, pos, x) || !get_double(in, pos, y)) return false;
+  if (!get_varint(in, pos, hp)) return false;
+  if (!get_varint(in, pos, orbs)) return false;
+
+  std::string enemy_state;
+  if (enemies) {
+    std::uint32_t size;
+    if (!get_varint(in, pos, size) || in.size() - pos < size) return false;
+    enemy_state = in.substr(pos, size);
+    pos += size;
+  }
+
+  std::vector<Dungeon::Change> journal;
+  while (pos < in.size()) {
+    const auto kind = static_cast<Dungeon::Change::Kind>(in[pos++]);
+    if (kind != Dungeon::Change::Kind::Activate &&
+        kind != Dungeon::Change::Kind::OpenDoor) {
+      return false;
+    }
+    std::uint32_t cx, cy;
+    if (!get_varint(in, pos, cx)) return false;
+    if (!get_varint(in, pos, cy)) return false;
+    journal.push_back({kind, {static_cast<int>(cx), static_cast<int>(cy)}});
+  }
+
+  seed_ = seed;
+  dungeon_seed_ = dungeon_seed;
+  mode_ = mode;
+  enemies_ = enemies;
+  x_ = x;
+  y_ = y;
+  hp_ = hp;
+  orbs_ = orbs;
+  enemy_state_.swap(enemy_state);
+  journal_.swap(journal);
+  return true;
+}
+
+bool SaveGame::write_file(const std::string& file, const std::string& data) {
+  const std::string temp = file + ".tmp";
+  {
+    std::ofstream writer(temp, std::ios::binary);
+    writer.write(data.data(), data.size());
+    writer.flush();
+    if (!writer.good()) return false;
+  }
+
+  // Renaming over a file that exists fails on Windows, where the old save
+  // has to go first.
+  if (std::rename(temp.c_str(), file.c_str()) != 0) {
+    std::remove(file.c_str());
+    return std::rename(temp.c_str(), file.c_str()) == 0;
+  }
+  return true;
+}
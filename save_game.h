@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dungeon.h"
+#include "enemies.h"
+#include "player.h"
+
+// A run in progress, kept as the seed it started from, the seed its dungeon
+// was made from, the dungeon's journal of changes, the little the player
+// carries and every enemy there is.  The dungeon is made again from its seed
+// when the run is restored, so a save without enemies is a few hundred bytes
+// however far the run has gone.
+class SaveGame {
+ public:
+  SaveGame();
+  // Enemies is null for runs without them.
+  SaveGame(unsigned int seed, const Dungeon& dungeon, const Player& player,
+           const Enemies* enemies);
+
+  // Takes the run as it is now, reusing the memory of the last time.
+  void update(unsigned int seed, const Dungeon& dungeon, const Player& player,
+              const Enemies* enemies);
+
+  // The run's seed, which enemies and replays are made from.
+  unsigned int seed() const { return seed_; }
+  Dungeon::Mode mode() const { return mode_; }
+  bool enemies() const { return enemies_; }
+
+  // Makes the dungeon again and replays its journal.  Only the game makes
+  // saves and its dungeons are all the same size, so that is left to it.
+  Dungeon dungeon(int size) const;
+  void restore(Player& player) const;
+  // Enemies made with the run's seed are left as they are if the saved ones
+  // don't load.
+  void restore(Enemies& enemies) const;
+
+  // Lays the save out as it is kept in a file, over what out held before.
+  void write(std::string& out) const;
+  bool save(const std::string& file) const;
+  bool load(const std::string& file);
+
+  // Writes a new file and then renames it over the old one, so a save that
+  // fails part way leaves the last one whole.
+  static bool write_file(const std::string& file, const std::string& data);
+
+ private:
+  static constexpr char kMagic[4] = {'M', 'S', 'A', 'V'};
+  static constexpr std::uint8_t kVersion = 4;
+  static constexpr std::uint8_t kEnemies = 1 << 0;
+
+  unsigned int seed_, dungeon_seed_;
+  Dungeon::Mode mode_;
+  bool enemies_;
+  double x_, y_;
+  int hp_, orbs_;
+  // As Enemies::save writes them.
+  std::string enemy_state_;
+  std::vector<Dungeon::Change> journal_;
+};
@@ -0,0 +1,87 @@
+#include "save_writer.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "allocations.h"
+#include "save_game.h"
+
+#ifdef SAVE_WRITER_THREAD
+
+SaveWriter::SaveWriter(const char* file)
+    : file_(file),
+      waiting_(),
+      writing_(),
+      pending_(false),
+      busy_(false),
+      stopping_(false),
+      mutex_(),
+      changed_(),
+      thread_(&SaveWriter::run, this) {}
+
+SaveWriter::~SaveWriter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  changed_.notify_all();
+  thread_.join();
+}
+
+void SaveWriter::write(std::string& data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waiting_.swap(data);
+    pending_ = true;
+  }
+  changed_.notify_all();
+}
+
+void SaveWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  changed_.wait(lock, [this] { return !pending_ && !busy_; });
+}
+
+void SaveWriter::remove() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  pending_ = false;
+  changed_.wait(lock, [this] { return !busy_; });
+  std::remove(file_);
+}
+
+// Saves are written outside the lock, so a frame handing over the next one
+// never waits on the disk.
+void SaveWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    changed_.wait(lock, [this] { return pending_ || stopping_; });
+    if (!pending_) return;
+
+    writing_.swap(waiting_);
+    pending_ = false;
+    busy_ = true;
+    lock.unlock();
+    SaveGame::write_file(file_, writing_);
+    lock.lock();
+    busy_ = false;
+    changed_.notify_all();
+  }
+}
+
+#else
+
+SaveWriter::SaveWriter(const char* file) : file_(file) {}
+
+SaveWriter::~SaveWriter() {}
+
+void SaveWriter::write(std::string& data) {
+  // There is no disk to wait on, only the names of the files to make.
+  Allocations::Exempt exempt;
+  SaveGame::write_file(file_, data);
+}
+
+void SaveWriter::flush() {}
+
+void SaveWriter::remove() { std::remove(file_); }
+
+#endif
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+
+#if !defined(__EMSCRIPTEN__) || defined(__EMSCRIPTEN_PTHREADS__)
+#define SAVE_WRITER_THREAD
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+// Writes saves to a file on a thread of its own, so frames only have to lay
+// them out.  Only the newest save is kept waiting, so one that comes in while
+// another is being written replaces any that was waiting before it.  Web
+// builds without threads write saves straight away, as their files are
+// only kept in memory.
+class SaveWriter {
+ public:
+  explicit SaveWriter(const char* file);
+  // Writes the waiting save first.
+  ~SaveWriter();
+
+  SaveWriter(const SaveWriter&) = delete;
+  SaveWriter& operator=(const SaveWriter&) = delete;
+
+  // Takes the save in data, and hands back a buffer from an earlier save
+  // for the next one to be laid out in.
+  void write(std::string& data);
+  // Waits until the waiting save has been written.
+  void flush();
+  // Drops the waiting save and removes the file, once any save already
+  // being written is done with it.
+  void remove();
+
+ private:
+  const char* file_;
+
+#ifdef SAVE_WRITER_THREAD
+  std::string waiting_, writing_;
+  bool pending_, busy_, stopping_;
+  std::mutex mutex_;
+  std::condition_variable changed_;
+  std::thread thread_;
+
+  void run();
+#endif
+};
@@ -0,0 +1,103 @@
+#include "sim.h"
+
+#include "hash.h"
+
+namespace {
+constexpr int kStartX = Sim::kDungeonSize / 2 * Dungeon::kTileSize - 8;
+constexpr int kStartY = (Sim::kDungeonSize - 1) * Dungeon::kTileSize;
+
+// Only these change any cells, so the view can be kept otherwise.
+constexpr unsigned int kChangesCells =
+    1u << static_cast<int>(Player::Sound::Activate) |
+    1u << static_cast<int>(Player::Sound::Unlock);
+}  // namespace
+
+Sim::Sim(unsigned int seed, Dungeon::Mode mode, bool enemies)
+    : dungeon_(kDungeonSize, kDungeonSize, seed, mode),
+      player_(kStartX, kStartY),
+      enemies_(),
+      view_({-1, -1}),
+      observation_() {
+  if (enemies) enemies_.emplace(seed);
+  observe(0);
+}
+
+void Sim::reset(unsigned int seed) {
+  dungeon_ = Dungeon(kDungeonSize, kDungeonSize, seed, dungeon_.mode());
+  player_ = Player(kStartX, kStartY);
+  if (enemies_) {
+    enemies_->clear();
+    enemies_->seed(seed);
+  }
+  view_ = {-1, -1};
+  observe(0);
+}
+
+void Sim::restore(const Snapshot& snapshot) {
+  dungeon_ = snapshot.dungeon;
+  player_ = snapshot.player;
+  enemies_ = snapshot.enemies;
+  view_ = {-1, -1};
+  observe(0);
+}
+
+const Sim::Observation& Sim::step(unsigned int buttons) {
+  return step(buttons, kTickTime);
+}
+
+const Sim::Observation& Sim::step(unsigned int buttons,
+                                  unsigned int elapsed) {
+  if (!player_.dead()) player_.control(dungeon_, buttons);
+  player_.update(dungeon_, elapsed);
+  if (enemies_) enemies_->update(dungeon_, player_, elapsed);
+  observe(player_.take_sounds());
+  return observation_;
+}
+
+std::uint64_t Sim::checksum() const {
+  const std::uint64_t hash =
+      hash_value(dungeon_.checksum(), player_.checksum());
+  return enemies_ ? hash_value(hash, enemies_->checksum()) : hash;
+}
+
+void Sim::observe(unsigned int events) {
+  Observation& o = observation_;
+  o.x = player_.x();
+  o.y = player_.y();
+  o.health = player_.health();
+  o.orbs = player_.orbs();
+  o.events = events;
+  o.result = player_.take_result();
+  o.done = player_.dead();
+
+  const auto p = dungeon_.grid_coords(o.x, o.y);
+  if (p.x != view_.x || p.y != view_.y || (events & kChangesCells)) {
+    view_ = p;
+    auto* cell = o.cells.data();
+    for (int y = p.y - kViewRadius; y <= p.y + kViewRadius; ++y) {
+      for (int x = p.x - kViewRadius; x <= p.x + kViewRadius; ++x) {
+        *cell++ = dungeon_.get_cell(x, y);
+      }
+    }
+  }
+
+  const auto& room = dungeon_.room(o.cells[o.cells.size() / 2].room);
+  o.room = room.number;
+  o.room_total = room.running_total;
+  o.room_target = room.target;
+}
+
+SimBatch::SimBatch(unsigned int first_seed, int count, Dungeon::Mode mode,
+                   bool enemies) {
+  sims_.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    sims_.emplace_back(first_seed + i, mode, enemies);
+  }
+}
+
+void SimBatch::step(const unsigned int* buttons) {
+  for (auto& sim : sims_) {
+    if (!sim.observation().done) sim.step(*buttons);
+    ++buttons;
+  }
+}
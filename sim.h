@@ -0,0 +1,92 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "dungeon.h"
+#include "enemies.h"
+#include "player.h"
+
+// Runs a game without any input, graphics or audio, one fixed tick at a time.
+class Sim {
+ public:
+  static constexpr int kDungeonSize = 1024;
+  static constexpr unsigned int kTickTime = 16;
+  static constexpr int kViewRadius = 3;
+  static constexpr int kViewSize = 2 * kViewRadius + 1;
+
+  struct Observation {
+    double x, y;
+    int health, orbs;
+    int room, room_total, room_target;
+    // Player::Sound bits for everything that happened during the tick.
+    unsigned int events;
+    // What activating a cell during the tick did, if the player did.
+    Dungeon::Result result;
+    bool done;
+    // Cells around the player, row by row, with the player in the middle.
+    std::array<Dungeon::Cell, kViewSize * kViewSize> cells;
+  };
+
+  // The game at one moment.  Copies share whatever parts of the dungeon
+  // and enemies neither has changed, so taking and copying them costs
+  // little more than a pointer a room.
+  struct Snapshot {
+    Dungeon dungeon;
+    Player player;
+    std::optional<Enemies> enemies;
+  };
+
+  // Rooms only fill with enemies if asked to, as they are off by default
+  // in the game too.
+  explicit Sim(unsigned int seed,
+               Dungeon::Mode mode = Dungeon::Mode::Classic,
+               bool enemies = false);
+
+  // Starts over with a new seed, the same kind of dungeon and enemies if
+  // there were any.
+  void reset(unsigned int seed);
+  const Observation& step(unsigned int buttons);
+  const Observation& step(unsigned int buttons, unsigned int elapsed);
+
+  Snapshot snapshot() const { return {dungeon_, player_, enemies_}; }
+  // Goes back to a snapshot, for trying something else from there.
+  void restore(const Snapshot& snapshot);
+
+  const Observation& observation() const { return observation_; }
+  const Dungeon& dungeon() const { return dungeon_; }
+  const Player& player() const { return player_; }
+  // Null unless the game has enemies.
+  const Enemies* enemies() const { return enemies_ ? &*enemies_ : nullptr; }
+  std::uint64_t checksum() const;
+
+ private:
+  Dungeon dungeon_;
+  Player player_;
+  std::optional<Enemies> enemies_;
+  Dungeon::Position view_;
+  Observation observation_;
+
+  void observe(unsigned int events);
+};
+
+// Many independent games kept side by side and stepped together.
+class SimBatch {
+ public:
+  SimBatch(unsigned int first_seed, int count,
+           Dungeon::Mode mode = Dungeon::Mode::Classic,
+           bool enemies = false);
+
+  int size() const { return sims_.size(); }
+  Sim& operator[](int i) { return sims_[i]; }
+  const Sim& operator[](int i) const { return sims_[i]; }
+
+  // Steps every game with its own button mask.  Finished games are left
+  // alone until they are reset.
+  void step(const unsigned int* buttons);
+
+ private:
+  std::vector<Sim> sims_;
+};
@@ -0,0 +1,39 @@
+#include "spatial_hash.h"
+
+#include <cassert>
+
+SpatialHash::SpatialHash(int capacity) : starts_() {
+  items_.reserve(capacity);
+  sorted_.reserve(capacity);
+}
+
+void SpatialHash::clear() { items_.clear(); }
+
+void SpatialHash::add(int id, const Rect& box) {
+  assert(box.right - box.left <= kCellSize && "box wider than a cell");
+  assert(box.bottom - box.top <= kCellSize && "box taller than a cell");
+  const int cx = cell(box.left), cy = cell(box.top);
+  items_.push_back(
+      {id, cx, cy, bucket(cx, cy), box.left, box.top, box.right, box.bottom});
+}
+
+// A counting sort by bucket.  Each bucket's count is turned into where it
+// ends, then items are placed from the back so that every bucket ends up
+// starting where it should, holding its items in the order they were added.
+void SpatialHash::build() {
+  starts_.fill(0);
+  for (const Item& item : items_) ++starts_[item.bucket];
+  for (int b = 0; b < kBuckets; ++b) starts_[b + 1] += starts_[b];
+
+  sorted_.resize(items_.size());
+  for (auto item = items_.rbegin(); item != items_.rend(); ++item) {
+    sorted_[--starts_[item->bucket]] = *item;
+  }
+}
+
+void SpatialHash::query(const Rect* boxes, int count,
+                        std::vector<Hit>& hits) const {
+  for (int q = 0; q < count; ++q) {
+    query(boxes[q], [q, &hits](int id) { hits.push_back({q, id}); });
+  }
+}
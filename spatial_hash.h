@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "config.h"
+#include "rect.h"
+
+// Finds which of a set of boxes overlap a query box, without testing every
+// one of them.  Boxes are filed under the tile their top left corner is in,
+// so a query only has to look at the tiles it covers and the ones just
+// above and to the left of it.  That only finds everything if no box is
+// bigger than a tile, which holds for anything the size of an entity.
+//
+// Tiles are hashed into a fixed number of buckets that are laid out end to
+// end by build(), so after the first few frames nothing is allocated.
+class SpatialHash {
+ public:
+  static constexpr int kCellSize = Config::kTileSize;
+
+  struct Hit {
+    int query, id;
+  };
+
+  explicit SpatialHash(int capacity);
+
+  void clear();
+  void add(int id, const Rect& box);
+  // Has to be called after adding boxes and before querying them.
+  void build();
+  int size() const { return items_.size(); }
+
+  // Calls found with the id of every box overlapping the given one.
+  template <typename F>
+  void query(const Rect& box, F found) const;
+  // Adds a hit for every box overlapping each of the given ones, with query
+  // being the index of the box it overlapped.
+  void query(const Rect* boxes, int count, std::vector<Hit>& hits) const;
+
+ private:
+  static constexpr int kSide = 32;
+  static constexpr int kBuckets = kSide * kSide;
+
+  struct Item {
+    int id, cx, cy, bucket;
+    double left, top, right, bottom;
+  };
+
+  std::vector<Item> items_, sorted_;
+  std::array<int, kBuckets + 1> starts_;
+
+  static int cell(double v) { return (int)std::floor(v / kCellSize); }
+  // Tiles wrap around a square of buckets, so any area smaller than the
+  // square has a bucket to each tile and neighbouring tiles in a row are in
+  // neighbouring buckets.
+  static int bucket(int cx, int cy) {
+    return (cx & (kSide - 1)) | (cy & (kSide - 1)) * kSide;
+  }
+};
+
+template <typename F>
+void SpatialHash::query(const Rect& box, F found) const {
+  const int x0 = cell(box.left) - 1, y0 = cell(box.top) - 1;
+  const int x1 = cell(box.right), y1 = cell(box.bottom);
+  for (int cy = y0; cy <= y1; ++cy) {
+    for (int cx = x0; cx <= x1; ++cx) {
+      const int b = bucket(cx, cy);
+      for (int i = starts_[b]; i < starts_[b + 1]; ++i) {
+        const Item& item = sorted_[i];
+        // Other tiles can share the bucket.
+        if (item.cx != cx || item.cy != cy) continue;
+        if (item.left <= box.right && box.left <= item.right &&
+            item.top <= box.bottom && box.top <= item.bottom) {
+          found(item.id);
+        }
+      }
+    }
+  }
+}
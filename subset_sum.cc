@@ -0,0 +1,82 @@
+#include "subset_sum.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+
+namespace {
+// Larger than any possible number of values, small enough that adding one
+// per value never wraps.
+constexpr std::uint8_t kUnreachable = 0x7f;
+
+// Bit s is set when some subset adds up to s.  Each value ORs in a copy of
+// the set shifted left by that value.  Walking the words from the top down
+// lets the shift happen in place, and the always-empty word in front keeps
+// the carry from the word below free of branches.  Words above the target
+// are never looked at.
+template <size_t N>
+bool reaches(const int* values, int count, int target) {
+  constexpr int kWords = N / 64;
+  std::array<std::uint64_t, kWords + 1> sums = {0, 1};
+
+  const int top = target / 64 + 1;
+  for (int n = 0; n < count; ++n) {
+    const int v = values[n];
+    const int words = v / 64;
+    const int bits = v % 64;
+    for (int i = top; i > words; --i) {
+      const std::uint64_t carry = (sums[i - words - 1] >> 1) >> (63 - bits);
+      sums[i] |= sums[i - words] << bits | carry;
+    }
+  }
+
+  return (sums[top] >> (target % 64)) & 1;
+}
+}  // namespace
+
+bool SubsetSum::reachable(const int* values, int count, int target) {
+  assert(target >= 0 && target <= kMaxTarget);
+  return target < 512 ? reaches<512>(values, count, target)
+                      : reaches<kMaxTarget + 1>(values, count, target);
+}
+
+SubsetSum SubsetSum::solve(const std::vector<int>& values, int target) {
+  assert(values.size() < kUnreachable);
+  if (!reachable(values, target)) return {0, {}};
+
+  // Each value adds a shifted copy of the previous row to the next one.  The
+  // rows never overlap, so both loops vectorize.  fewest keeps every row so
+  // that a minimal solution can be traced back afterwards.
+  const int n = values.size();
+  const int width = target + 1;
+  std::vector<std::uint32_t> counts(width, 0), next_counts(width);
+  std::vector<std::uint8_t> fewest((n + 1) * width, kUnreachable);
+  counts[0] = 1;
+  fewest[0] = 0;
+
+  for (int i = 0; i < n; ++i) {
+    const int v = std::min(values[i], width);
+    const std::uint8_t* prev = &fewest[i * width];
+    std::uint8_t* next = &fewest[(i + 1) * width];
+
+    for (int s = 0; s < v; ++s) {
+      next_counts[s] = counts[s];
+      next[s] = prev[s];
+    }
+    for (int s = v; s < width; ++s) {
+      next_counts[s] = counts[s] + counts[s - v];
+      next[s] = std::min<std::uint8_t>(prev[s], prev[s - v] + 1);
+    }
+    counts.swap(next_counts);
+  }
+
+  std::vector<int> minimum;
+  for (int i = n, s = target; i > 0 && s > 0; --i) {
+    if (fewest[i * width + s] != fewest[(i - 1) * width + s]) {
+      minimum.push_back(i - 1);
+      s -= values[i - 1];
+    }
+  }
+
+  return {counts[target], minimum};
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Exact subset sums over a room's value cells.
+struct SubsetSum {
+  static constexpr int kMaxTarget = 4095;
+
+  // Number of distinct sets of values that add up to exactly the target.
+  std::uint64_t count;
+  // Indices of a solution that uses as few values as possible.
+  std::vector<int> minimum;
+
+  bool solvable() const { return count > 0; }
+
+  // Only checks whether any subset adds up to target.  This is cheap enough
+  // to run on every room as it is generated.
+  static bool reachable(const int* values, int count, int target);
+  static bool reachable(const std::vector<int>& values, int target) {
+    return reachable(values.data(), values.size(), target);
+  }
+
+  // Counts every solution and finds a minimal one, in time proportional to
+  // the number of values times the target.
+  static SubsetSum solve(const std::vector<int>& values, int target);
+};
@@ -0,0 +1,62 @@
+// Plays a run with enemies through the dungeon screen, wandering about and
+// fighting at random, and fails if any frame after the warm up allocates.
+// Enemies hurt the player, so the run is saved along the way.  Only builds
+// with assertions count allocations, so built without them this checks
+// nothing.
+
+#include <cstdint>
+#include <cstdio>
+
+#include "allocations.h"
+#include "config.h"
+#include "dungeon_screen.h"
+#include "player.h"
+
+namespace {
+
+constexpr unsigned int kSeed = 7;
+constexpr int kFrames = 20000;
+constexpr unsigned int kFrameTime = 16;
+
+}  // namespace
+
+int main() {
+#ifdef NDEBUG
+  std::fprintf(stderr, "built without assertions, allocations not counted\n");
+#endif
+
+  int failures = 0;
+  Audio audio;
+  {
+    DungeonScreen screen(kSeed, DungeonScreen::generate(kSeed), true);
+
+    std::uint32_t state = kSeed;
+    unsigned int held = 0;
+    unsigned long warm = 0;
+    int frame = 0;
+    for (; frame < kFrames; ++frame) {
+      state ^= state << 13;
+      state ^= state >> 17;
+      state ^= state << 5;
+      if (state % 32 == 0) held = 1u << (state >> 5) % 4;
+      unsigned int buttons = held;
+      if ((state >> 9) % 50 == 0) buttons |= Player::kInteract;
+      if ((state >> 15) % 90 == 0) buttons |= Player::kFocus;
+
+      if (frame == DungeonScreen::kWarmupFrames) warm = Allocations::count();
+      if (!screen.update(buttons, audio, kFrameTime)) break;
+      screen.draw(kConfig.graphics.width, kConfig.graphics.height);
+    }
+
+    if (Allocations::count() != warm) {
+      std::printf("%lu allocations after warming up\n",
+                  Allocations::count() - warm);
+      ++failures;
+    }
+    std::printf("%d frames\n", frame);
+  }
+
+  std::remove(DungeonScreen::kSaveFile);
+  std::remove(DungeonScreen::kReplayFile);
+  return failures > 0;
+}
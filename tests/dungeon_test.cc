@@ -0,0 +1,172 @@
+// Checks the dungeon's walkable bits against its tiles, both as made and
+// after every door has been opened, and box collision built on the bits
+// against testing each corner of the box by its tile.  Sweeps are checked
+// against moving the box a pixel at a time: every pixel up to where a box
+// stops has to be clear and, unless it went the whole way, the next one
+// not.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "dungeon.h"
+#include "room_templates.h"
+
+namespace {
+
+constexpr int kSize = 1024;
+constexpr int kSeeds = 3;
+constexpr int kBoxes = 4096;
+constexpr int kBatch = 64;
+// Sweeps go up to this many tiles at once, far enough to cross any wall.
+constexpr int kSweepTiles = 10;
+// Failures past this many are only counted.
+constexpr int kShown = 20;
+
+int failures = 0;
+
+void expect(bool ok, const char* what, unsigned int seed, int x, int y) {
+  if (ok) return;
+  if (++failures <= kShown) {
+    std::printf("seed %u: %s at %d, %d\n", seed, what, x, y);
+  }
+}
+
+bool tile_walkable(const Dungeon& dungeon, int x, int y) {
+  const auto tile = dungeon.get_cell(x, y).tile;
+  return tile == Dungeon::Tile::Room || tile == Dungeon::Tile::DoorOpen ||
+         tile == Dungeon::Tile::Sand;
+}
+
+bool box_walkable(const Dungeon& dungeon, const Dungeon::Box& box) {
+  const auto a = dungeon.grid_coords(box.left, box.top);
+  const auto b = dungeon.grid_coords(box.right, box.bottom);
+  return tile_walkable(dungeon, a.x, a.y) && tile_walkable(dungeon, a.x, b.y) &&
+         tile_walkable(dungeon, b.x, a.y) && tile_walkable(dungeon, b.x, b.y);
+}
+
+void check_cells(const Dungeon& dungeon, unsigned int seed) {
+  for (int y = -1; y <= kSize; ++y) {
+    for (int x = -1; x <= kSize; ++x) {
+      expect(dungeon.walkable(x, y) == tile_walkable(dungeon, x, y),
+             "walkable bit doesn't match tile", seed, x, y);
+    }
+  }
+}
+
+// Boxes the size of an entity or so, anywhere in or just around a room.
+void check_boxes(const Dungeon& dungeon, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> rand_room(0, Dungeon::kRoomCount - 1);
+  std::uniform_real_distribution<double> rand_x(
+      -2, RoomTemplates::kWidth + 3);
+  std::uniform_real_distribution<double> rand_y(
+      -2, RoomTemplates::kHeight + 3);
+  std::uniform_real_distribution<double> rand_extent(2, 8);
+
+  Dungeon::Box boxes[kBatch];
+  bool walkable[kBatch];
+  for (int n = 0; n < kBoxes; n += kBatch) {
+    for (auto& box : boxes) {
+      int room = rand_room(rng);
+      if (!dungeon.room(room)) room = 0;
+      const auto o = dungeon.room_origin(room);
+      const double x = (o.x + rand_x(rng)) * Dungeon::kTileSize;
+      const double y = (o.y + rand_y(rng)) * Dungeon::kTileSize;
+      const double extent = rand_extent(rng);
+      box = {x - extent, y - extent, x + extent, y + extent};
+    }
+
+    dungeon.box_walkable(boxes, kBatch, walkable);
+    for (int i = 0; i < kBatch; ++i) {
+      const auto p = dungeon.grid_coords(boxes[i].left, boxes[i].top);
+      const bool expected = box_walkable(dungeon, boxes[i]);
+      expect(dungeon.box_walkable(boxes[i]) == expected,
+             "box walkable doesn't match its corners", seed, p.x, p.y);
+      expect(walkable[i] == expected,
+             "batched box walkable doesn't match its corners", seed, p.x,
+             p.y);
+    }
+  }
+}
+
+Dungeon::Box moved(const Dungeon::Box& box, double dx, double dy) {
+  return {box.left + dx, box.top + dy, box.right + dx, box.bottom + dy};
+}
+
+void check_sweep(const Dungeon& dungeon, const Dungeon::Box& box,
+                 double delta, bool horizontal, unsigned int seed) {
+  const double distance = horizontal ? dungeon.sweep_x(box, delta)
+                                     : dungeon.sweep_y(box, delta);
+  const auto p = dungeon.grid_coords(box.left, box.top);
+  const double step = delta > 0 ? 1 : -1;
+  auto at = [&box, horizontal](double d) {
+    return horizontal ? moved(box, d, 0) : moved(box, 0, d);
+  };
+
+  expect(std::abs(distance) <= std::abs(delta) && distance * delta >= 0,
+         "sweep went further than asked or backwards", seed, p.x, p.y);
+  for (double d = 0; std::abs(d) < std::abs(distance); d += step) {
+    expect(box_walkable(dungeon, at(d)), "sweep passed through a wall", seed,
+           p.x, p.y);
+  }
+  expect(box_walkable(dungeon, at(distance)), "sweep ended in a wall", seed,
+         p.x, p.y);
+  if (std::abs(distance) < std::abs(delta)) {
+    const double next = std::abs(distance) + 1 <= std::abs(delta)
+                            ? distance + step
+                            : delta;
+    expect(!box_walkable(dungeon, at(next)), "sweep stopped short", seed,
+           p.x, p.y);
+  }
+}
+
+// Boxes start anywhere they fit in a room and move any way at all.
+void check_sweeps(const Dungeon& dungeon, unsigned int seed) {
+  std::mt19937 rng(seed);
+  std::uniform_int_distribution<int> rand_room(0, Dungeon::kRoomCount - 1);
+  std::uniform_real_distribution<double> rand_x(0, RoomTemplates::kWidth + 1);
+  std::uniform_real_distribution<double> rand_y(0,
+                                                RoomTemplates::kHeight + 1);
+  std::uniform_real_distribution<double> rand_delta(
+      -kSweepTiles * Dungeon::kTileSize, kSweepTiles * Dungeon::kTileSize);
+
+  for (int n = 0; n < kBoxes; ++n) {
+    int room = rand_room(rng);
+    if (!dungeon.room(room)) room = 0;
+    const auto o = dungeon.room_origin(room);
+    const double x = (o.x + rand_x(rng)) * Dungeon::kTileSize;
+    const double y = (o.y + rand_y(rng)) * Dungeon::kTileSize;
+    const Dungeon::Box box = {x - 7, y - 7, x + 7, y + 7};
+    if (!box_walkable(dungeon, box)) continue;
+
+    check_sweep(dungeon, box, rand_delta(rng), true, seed);
+    check_sweep(dungeon, box, rand_delta(rng), false, seed);
+  }
+}
+
+void check(Dungeon dungeon, unsigned int seed) {
+  check_cells(dungeon, seed);
+  check_boxes(dungeon, seed);
+  check_sweeps(dungeon, seed);
+
+  for (const auto& door : dungeon.doors()) {
+    dungeon.open_door(door.position.x, door.position.y);
+  }
+  check_cells(dungeon, seed);
+  check_boxes(dungeon, seed);
+  check_sweeps(dungeon, seed);
+}
+
+}  // namespace
+
+int main() {
+  for (unsigned int seed = 1; seed <= kSeeds; ++seed) {
+    check(Dungeon(kSize, kSize, seed), seed);
+    check(Dungeon(kSize, kSize, seed, Dungeon::Mode::Endless), seed);
+  }
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
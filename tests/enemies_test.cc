@@ -0,0 +1,122 @@
+// Checks that enemy pools fill up without allocating and stay packed as
+// enemies die, and that an enemy in a pool is hurt and knocked back by the
+// player's attack exactly as an Entity is.
+
+#include <cstdio>
+
+#include "allocations.h"
+#include "dungeon.h"
+#include "enemies.h"
+#include "entity.h"
+#include "player.h"
+
+namespace {
+
+constexpr int kSize = 1024;
+constexpr unsigned int kSeed = 5;
+constexpr unsigned int kFrameTime = 16;
+// Slimes take two hits, as in Enemies::kTypes.
+constexpr int kSlimeHealth = 2;
+
+int failures = 0;
+
+void expect(bool ok, const char* what) {
+  if (ok) return;
+  std::printf("%s\n", what);
+  ++failures;
+}
+
+// The top of a column of plain floor, three cells deep and a cell either
+// side, for the player to stand in and attack down.
+Dungeon::Position open_floor(const Dungeon& dungeon, int room) {
+  const auto o = dungeon.room_origin(room);
+  for (int y = o.y; y < o.y + 8; ++y) {
+    for (int x = o.x; x < o.x + 12; ++x) {
+      bool open = true;
+      for (int dy = 0; dy < 4; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+          const auto cell = dungeon.get_cell(x + dx, y + dy);
+          open &= cell.tile == Dungeon::Tile::Room && cell.value == 0;
+        }
+      }
+      if (open) return {x, y};
+    }
+  }
+  return {-1, -1};
+}
+
+void check_pool(const Dungeon& dungeon) {
+  Enemies enemies(kSeed);
+  const unsigned long before = Allocations::count();
+  for (int i = 0; i < Enemies::kCapacity; ++i) {
+    enemies.spawn(Enemies::Kind::Slime, 8 * i, 0);
+  }
+  expect(Allocations::count() == before, "spawning allocated");
+  expect(enemies.count(Enemies::Kind::Slime) == Enemies::kCapacity,
+         "pool didn't fill");
+  expect(!enemies.spawn(Enemies::Kind::Slime, 0, 0), "pool overfilled");
+  expect(enemies.spawn(Enemies::Kind::Bat, 0, 0), "kinds share a pool");
+
+  // Everything is out of bounds, so it is all buried on the next update.
+  Player player(0, 0);
+  enemies.update(dungeon, player, kFrameTime);
+  expect(enemies.count() == 0, "enemies out of bounds weren't buried");
+  expect(enemies.spawn(Enemies::Kind::Slime, 0, 0),
+         "pool didn't make room again");
+}
+
+void check_knockback(Dungeon& dungeon) {
+  const auto p = open_floor(dungeon, 1);
+  expect(p.x >= 0, "no open floor to test on");
+  if (p.x < 0) return;
+
+  Player player(0, 0);
+  player.set_position((p.x + 0.5) * Dungeon::kTileSize,
+                      (p.y + 0.5) * Dungeon::kTileSize);
+  player.control(dungeon, Player::kDown);
+  player.control(dungeon, Player::kInteract);
+  const Rect attack = player.attack_box();
+  expect(attack.height() != 0, "player didn't attack");
+
+  const double x = (attack.left + attack.right) / 2;
+  const double y = (attack.top + attack.bottom) / 2;
+  Enemies enemies(kSeed);
+  enemies.spawn(Enemies::Kind::Slime, x, y);
+  Entity entity({nullptr, kSlimeHealth}, x, y);
+
+  // Nothing moves in a tick that takes no time, so the hit lands on both
+  // from the same place.
+  enemies.update(dungeon, player, 0);
+  entity.hit(player.damage(), player.x(), player.y());
+  expect(enemies.health(Enemies::Kind::Slime, 0) == entity.health(),
+         "hit did different damage");
+  expect(entity.health() < kSlimeHealth, "attack missed");
+
+  for (int t = 0; t < Entity::kKnockbackTime; t += kFrameTime) {
+    enemies.update(dungeon, player, kFrameTime);
+    entity.update(dungeon, kFrameTime);
+    if (enemies.x(Enemies::Kind::Slime, 0) != entity.x() ||
+        enemies.y(Enemies::Kind::Slime, 0) != entity.y()) {
+      std::printf("knocked back to %.2f, %.2f rather than %.2f, %.2f\n",
+                  enemies.x(Enemies::Kind::Slime, 0),
+                  enemies.y(Enemies::Kind::Slime, 0), entity.x(),
+                  entity.y());
+      ++failures;
+      break;
+    }
+  }
+  expect(entity.x() != x || entity.y() != y, "entity wasn't knocked back");
+  expect(enemies.health(Enemies::Kind::Slime, 0) == entity.health(),
+         "second hit landed through iframes");
+}
+
+}  // namespace
+
+int main() {
+  Dungeon dungeon(kSize, kSize, kSeed);
+  check_pool(dungeon);
+  check_knockback(dungeon);
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
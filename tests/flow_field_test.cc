@@ -0,0 +1,195 @@
+// Checks flow fields against a breadth first search of the room's tiles
+// for every target a room has: each cell has to reach the target exactly
+// when the search does, and step to a neighbour one closer.  Fields also
+// have to search again when a door opens, and only then or when the target
+// moves.
+
+#include <array>
+#include <cstdio>
+
+#include "dungeon.h"
+#include "flow_field.h"
+
+namespace {
+
+constexpr int kSize = 1024;
+constexpr int kSeeds = 3;
+constexpr int kUnreached = -1;
+// Failures past this many are only counted.
+constexpr int kShown = 20;
+
+int failures = 0;
+
+void expect(bool ok, const char* what, unsigned int seed, int x, int y) {
+  if (ok) return;
+  if (++failures <= kShown) {
+    std::printf("seed %u: %s at %d, %d\n", seed, what, x, y);
+  }
+}
+
+bool tile_walkable(const Dungeon& dungeon, int x, int y) {
+  const auto tile = dungeon.get_cell(x, y).tile;
+  return tile == Dungeon::Tile::Room || tile == Dungeon::Tile::DoorOpen ||
+         tile == Dungeon::Tile::Sand;
+}
+
+// Steps to a room's cells from the target, walls and doorways included, or
+// kUnreached.
+class Distances {
+ public:
+  Distances(const Dungeon& dungeon, Dungeon::Position origin,
+            Dungeon::Position target)
+      : origin_(origin) {
+    distance_.fill(kUnreached);
+    if (!tile_walkable(dungeon, target.x, target.y)) return;
+
+    std::array<Dungeon::Position, kCells> queue;
+    int head = 0, tail = 0;
+    queue[tail++] = target;
+    distance_[index(target.x, target.y)] = 0;
+    while (head < tail) {
+      const auto p = queue[head++];
+      const int next = get(p.x, p.y) + 1;
+      const Dungeon::Position neighbors[] = {
+          {p.x, p.y - 1}, {p.x + 1, p.y}, {p.x, p.y + 1}, {p.x - 1, p.y}};
+      for (const auto& n : neighbors) {
+        if (!inside(n.x, n.y) || get(n.x, n.y) != kUnreached) continue;
+        if (!tile_walkable(dungeon, n.x, n.y)) continue;
+        distance_[index(n.x, n.y)] = next;
+        queue[tail++] = n;
+      }
+    }
+  }
+
+  int get(int x, int y) const {
+    return inside(x, y) ? distance_[index(x, y)] : kUnreached;
+  }
+
+ private:
+  static constexpr int kCells = FlowField::kWidth * FlowField::kHeight;
+
+  Dungeon::Position origin_;
+  std::array<int, kCells> distance_;
+
+  bool inside(int x, int y) const {
+    return x >= origin_.x && x < origin_.x + FlowField::kWidth &&
+           y >= origin_.y && y < origin_.y + FlowField::kHeight;
+  }
+  int index(int x, int y) const {
+    return (y - origin_.y) * FlowField::kWidth + x - origin_.x;
+  }
+};
+
+Dungeon::Position step(int x, int y, Entity::Direction d) {
+  switch (d) {
+    case Entity::Direction::North:
+      return {x, y - 1};
+    case Entity::Direction::East:
+      return {x + 1, y};
+    case Entity::Direction::South:
+      return {x, y + 1};
+    case Entity::Direction::West:
+      return {x - 1, y};
+  }
+  return {x, y};
+}
+
+// Compares the field with the search over the room and the cells around
+// it, which the field should never reach.
+void check_field(const Dungeon& dungeon, unsigned int seed,
+                 const FlowField& field, const Distances& distances,
+                 Dungeon::Position origin) {
+  for (int y = origin.y - 1; y <= origin.y + FlowField::kHeight; ++y) {
+    for (int x = origin.x - 1; x <= origin.x + FlowField::kWidth; ++x) {
+      const int here = distances.get(x, y);
+      expect(field.reaches(x, y) == (here != kUnreached),
+             "field reaches a different cell", seed, x, y);
+
+      Entity::Direction d;
+      const bool moves = field.direction(x, y, d);
+      expect(moves == (here > 0), "field moves from a different cell", seed,
+             x, y);
+      if (!moves) continue;
+      const auto next = step(x, y, d);
+      expect(tile_walkable(dungeon, next.x, next.y),
+             "field steps onto a wall", seed, x, y);
+      expect(distances.get(next.x, next.y) == here - 1,
+             "field steps somewhere no closer", seed, x, y);
+    }
+  }
+}
+
+void check_room(const Dungeon& dungeon, unsigned int seed, int room) {
+  const auto origin = dungeon.room_origin(room);
+  FlowField field;
+  for (int y = origin.y; y < origin.y + FlowField::kHeight; ++y) {
+    for (int x = origin.x; x < origin.x + FlowField::kWidth; ++x) {
+      // Doorways belong to neither room, so fields targeting them are left
+      // on the room they were on; rooms start with a target inside them.
+      const auto cell = dungeon.get_cell(x, y);
+      if (cell.is_door() || cell.room != room) continue;
+      field.update(dungeon, {x, y});
+      check_field(dungeon, seed, field, Distances(dungeon, origin, {x, y}),
+                  origin);
+    }
+  }
+}
+
+// Targets the first cell that can be walked on and opens each of the
+// room's doors in turn.
+void check_cache(Dungeon& dungeon, unsigned int seed, int room) {
+  const auto origin = dungeon.room_origin(room);
+  Dungeon::Position target = {-1, -1};
+  for (int y = origin.y; y < origin.y + FlowField::kHeight; ++y) {
+    for (int x = origin.x; x < origin.x + FlowField::kWidth; ++x) {
+      const auto cell = dungeon.get_cell(x, y);
+      if (target.x < 0 && !cell.is_door() && cell.room == room &&
+          tile_walkable(dungeon, x, y)) {
+        target = {x, y};
+      }
+    }
+  }
+  if (target.x < 0) return;
+
+  FlowField field;
+  field.update(dungeon, target);
+  const int searches = field.searches();
+  expect(searches == 1, "field didn't search", seed, target.x, target.y);
+  field.update(dungeon, target);
+  expect(field.searches() == searches, "field searched for nothing", seed,
+         target.x, target.y);
+
+  for (const auto& door : dungeon.doors(room)) {
+    const auto p = door.position;
+    if (tile_walkable(dungeon, p.x, p.y)) continue;
+    const int before = field.searches();
+    dungeon.open_door(p.x, p.y);
+    field.update(dungeon, target);
+    expect(field.searches() == before + 1,
+           "field didn't search after a door opened", seed, p.x, p.y);
+    const Distances distances(dungeon, origin, target);
+    expect(distances.get(p.x, p.y) != kUnreached, "opened door is unreached",
+           seed, p.x, p.y);
+    check_field(dungeon, seed, field, distances, origin);
+  }
+}
+
+void check(Dungeon dungeon, unsigned int seed) {
+  for (int room = 0; room < Dungeon::kRoomCount; ++room) {
+    if (room != 0 && !dungeon.room(room)) continue;
+    check_room(dungeon, seed, room);
+    check_cache(dungeon, seed, room);
+  }
+}
+
+}  // namespace
+
+int main() {
+  for (unsigned int seed = 1; seed <= kSeeds; ++seed) {
+    check(Dungeon(kSize, kSize, seed), seed);
+    check(Dungeon(kSize, kSize, seed, Dungeon::Mode::Endless), seed);
+  }
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -0,0 +1,144 @@
+// Records runs of random input through the sim, for both kinds of dungeon
+// with and without enemies, and checks that each survives saving and
+// loading and plays back to the same state.  Runs are long enough to
+// outgrow the room replays keep up front.  Cutting a saved replay short
+// either loses whole runs off the end or fails, leaving what was loaded
+// before alone.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "player.h"
+#include "replay.h"
+#include "sim.h"
+
+namespace {
+
+constexpr unsigned int kSeed = 3;
+constexpr int kTicks = 20000;
+// Input changes about this often, so kTicks makes more runs than replays
+// keep room for.
+constexpr int kChangeTicks = 2;
+// Cuts are tried this many bytes apart.
+constexpr int kCutStep = 7;
+constexpr char kFile[] = "replay_test.rep";
+
+int failures = 0;
+
+void expect(bool ok, const char* what, unsigned int seed, int at) {
+  if (ok) return;
+  std::printf("seed %u: %s at %d\n", seed, what, at);
+  ++failures;
+}
+
+bool same_runs(const Replay& a, const Replay& b, size_t count) {
+  if (a.runs().size() < count || b.runs().size() < count) return false;
+  for (size_t i = 0; i < count; ++i) {
+    const auto& x = a.runs()[i];
+    const auto& y = b.runs()[i];
+    if (x.ticks != y.ticks || x.buttons != y.buttons ||
+        x.elapsed != y.elapsed) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::uint64_t play(const Replay& replay) {
+  Sim sim(replay.seed(), replay.mode(), replay.enemies());
+  for (const auto& run : replay.runs()) {
+    for (std::uint32_t i = 0; i < run.ticks; ++i) {
+      sim.step(run.buttons, run.elapsed);
+    }
+  }
+  return sim.checksum();
+}
+
+void check_cuts(const Replay& replay, unsigned int seed) {
+  std::ifstream reader(kFile, std::ios::binary);
+  const std::string saved((std::istreambuf_iterator<char>(reader)),
+                          std::istreambuf_iterator<char>());
+
+  for (size_t size = 0; size < saved.size(); size += kCutStep) {
+    {
+      std::ofstream writer(kFile, std::ios::binary | std::ios::trunc);
+      writer.write(saved.data(), size);
+    }
+    Replay cut = replay;
+    if (cut.load(kFile)) {
+      expect(cut.runs().size() < replay.runs().size() &&
+                 same_runs(cut, replay, cut.runs().size()),
+             "cut replay loaded runs it didn't have", seed, size);
+    } else {
+      expect(same_runs(cut, replay, replay.runs().size()),
+             "failed load changed the replay", seed, size);
+    }
+  }
+}
+
+void check(unsigned int seed, Dungeon::Mode mode, bool enemies) {
+  Replay replay(seed, mode, enemies);
+  Sim sim(seed, mode, enemies);
+  std::uint32_t state = seed;
+  unsigned int buttons = 0, elapsed = Sim::kTickTime, changes = 0;
+  for (int tick = 0; tick < kTicks; ++tick) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    if (state % kChangeTicks == 0) {
+      unsigned int next = 1u << (state >> 5) % 4;
+      if ((state >> 9) % 8 == 0) next |= Player::kInteract;
+      // Frames run long now and then.
+      const unsigned int next_elapsed =
+          (state >> 15) % 16 == 0 ? 2 * Sim::kTickTime : Sim::kTickTime;
+      if (next != buttons || next_elapsed != elapsed) ++changes;
+      buttons = next;
+      elapsed = next_elapsed;
+    }
+    replay.record(buttons, elapsed);
+    sim.step(buttons, elapsed);
+  }
+
+  expect(replay.ticks() == kTicks, "ticks went missing", seed, kTicks);
+  // The first tick starts a run whatever it is.
+  expect(replay.runs().size() <= changes + 1, "runs weren't merged", seed,
+         replay.runs().size());
+  expect(play(replay) == sim.checksum(), "recording played back differently",
+         seed, kTicks);
+
+  expect(replay.save(kFile), "couldn't save", seed, 0);
+  Replay loaded;
+  expect(loaded.load(kFile), "couldn't load", seed, 0);
+  expect(loaded.seed() == seed && loaded.mode() == mode &&
+             loaded.enemies() == enemies,
+         "loaded a different game", seed, 0);
+  expect(loaded.runs().size() == replay.runs().size() &&
+             same_runs(loaded, replay, replay.runs().size()),
+         "loaded different runs", seed, 0);
+  expect(play(loaded) == sim.checksum(), "loaded replay played differently",
+         seed, kTicks);
+
+  check_cuts(loaded, seed);
+  std::remove(kFile);
+}
+
+}  // namespace
+
+int main() {
+  for (const auto mode : {Dungeon::Mode::Classic, Dungeon::Mode::Endless}) {
+    check(kSeed, mode, false);
+    check(kSeed, mode, true);
+  }
+
+  Replay missing;
+  if (missing.load(kFile)) {
+    std::printf("loaded a replay that doesn't exist\n");
+    ++failures;
+  }
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
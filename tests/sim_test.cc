@@ -0,0 +1,132 @@
+// Checks that restoring a snapshot brings the sim back exactly, so that
+// playing the same input from it again ends the same, for both kinds of
+// dungeon with enemies.  Snapshots share rooms and enemies with whatever
+// they were copied from and to, so several sims are forked from one and
+// played apart, and neither the snapshot, the original nor any other fork
+// may see the changes.  Every fork's dungeon also has to match one made
+// again from its journal.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "dungeon.h"
+#include "player.h"
+#include "sim.h"
+
+namespace {
+
+constexpr unsigned int kSeeds = 8;
+constexpr int kWarmupTicks = 1000;
+constexpr int kTicks = 3000;
+constexpr int kForks = 4;
+
+int failures = 0;
+
+void expect(bool ok, const char* what, unsigned int seed, int fork) {
+  if (ok) return;
+  std::printf("seed %u, fork %d: %s\n", seed, fork, what);
+  ++failures;
+}
+
+// Spends a while at a time walking one way, standing still to activate
+// the cell underfoot or swinging.
+class Buttons {
+ public:
+  explicit Buttons(std::uint32_t seed) : state_(seed * 2654435761u + 7) {}
+
+  unsigned int next() {
+    const bool first = tick_++ % kPhaseTicks == 0;
+    if (first) {
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 17;
+      state_ ^= state_ << 5;
+      action_ = state_ % 6;
+    }
+    if (action_ < 4) return kDirections[action_];
+    if (!first) return 0;
+    return action_ == 4 ? Player::kFocus : Player::kInteract;
+  }
+
+  std::vector<unsigned int> plan(int ticks) {
+    std::vector<unsigned int> buttons(ticks);
+    for (auto& b : buttons) b = next();
+    return buttons;
+  }
+
+ private:
+  // Long enough to stand still while focusing.
+  static constexpr int kPhaseTicks = 40;
+  static constexpr unsigned int kDirections[] = {
+      Player::kLeft, Player::kRight, Player::kUp, Player::kDown};
+
+  std::uint32_t state_;
+  int tick_ = 0;
+  unsigned int action_ = 0;
+};
+
+std::uint64_t play(Sim& sim, const std::vector<unsigned int>& plan) {
+  for (unsigned int buttons : plan) sim.step(buttons);
+  return sim.checksum();
+}
+
+void check(unsigned int seed, Dungeon::Mode mode) {
+  Sim sim(seed, mode, true);
+  // Wandering rarely finds the way out of the entrance, so the player
+  // starts on a value in the first room, among its enemies.
+  Sim::Snapshot first = sim.snapshot();
+  const auto cell = first.dungeon.value_cells(1).front();
+  first.player.set_position((cell.x + 0.5) * Dungeon::kTileSize,
+                            (cell.y + 0.5) * Dungeon::kTileSize);
+  sim.restore(first);
+  Buttons buttons(seed);
+  play(sim, buttons.plan(kWarmupTicks));
+
+  const Sim::Snapshot snapshot = sim.snapshot();
+  const std::uint64_t start = sim.checksum();
+  const std::uint64_t start_dungeon = snapshot.dungeon.checksum();
+  const std::uint64_t start_enemies = snapshot.enemies->checksum();
+  const std::vector<unsigned int> plan = buttons.plan(kTicks);
+  const std::uint64_t end = play(sim, plan);
+
+  sim.restore(snapshot);
+  expect(sim.checksum() == start, "restored to a different state", seed, -1);
+  expect(play(sim, plan) == end, "played differently after restoring", seed,
+         -1);
+
+  std::vector<Sim> forks(kForks, Sim(seed, mode, true));
+  std::vector<std::uint64_t> ends;
+  for (int f = 0; f < kForks; ++f) {
+    forks[f].restore(snapshot);
+    ends.push_back(play(forks[f], buttons.plan(kTicks)));
+  }
+  expect(sim.checksum() == end, "original changed by forks", seed, -1);
+  expect(snapshot.dungeon.checksum() == start_dungeon &&
+             snapshot.enemies->checksum() == start_enemies,
+         "snapshot changed by forks", seed, -1);
+
+  for (int f = 0; f < kForks; ++f) {
+    expect(forks[f].checksum() == ends[f], "fork changed by other forks",
+           seed, f);
+    Dungeon dungeon(Sim::kDungeonSize, Sim::kDungeonSize, seed, mode);
+    dungeon.replay(forks[f].dungeon().journal());
+    expect(dungeon.checksum() == forks[f].dungeon().checksum(),
+           "fork's dungeon doesn't match its journal", seed, f);
+  }
+
+  // Forks playing the same input from the snapshot end the same way.
+  forks[0].restore(snapshot);
+  expect(play(forks[0], plan) == end, "fork played differently", seed, 0);
+}
+
+}  // namespace
+
+int main() {
+  for (unsigned int seed = 1; seed <= kSeeds; ++seed) {
+    check(seed, Dungeon::Mode::Classic);
+    check(seed, Dungeon::Mode::Endless);
+  }
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
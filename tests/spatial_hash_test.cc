@@ -0,0 +1,115 @@
+// Checks the spatial hash against testing every box, for boxes up to a
+// tile in size scattered widely enough that tiles share buckets, queried
+// one at a time and in batches, and across clearing and rebuilding.
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "spatial_hash.h"
+
+namespace {
+
+constexpr int kRounds = 16;
+constexpr int kBoxes = 512;
+constexpr int kQueries = 256;
+// Boxes go this many tiles either side of the origin, more than the hash
+// has buckets across so distant tiles end up in the same bucket.
+constexpr int kSpread = 20;
+// Queries go up to this many tiles on a side.
+constexpr int kQueryTiles = 4;
+// Failures past this many are only counted.
+constexpr int kShown = 20;
+
+int failures = 0;
+
+void expect(bool ok, const char* what, int round, int query) {
+  if (ok) return;
+  if (++failures <= kShown) {
+    std::printf("round %d, query %d: %s\n", round, query, what);
+  }
+}
+
+Rect random_box(std::mt19937& rng, double size) {
+  std::uniform_real_distribution<double> place(
+      -kSpread * SpatialHash::kCellSize, kSpread * SpatialHash::kCellSize);
+  std::uniform_real_distribution<double> side(0, size);
+  const double x = place(rng), y = place(rng);
+  return Rect(x, y, x + side(rng), y + side(rng));
+}
+
+bool overlap(const Rect& a, const Rect& b) {
+  return a.left <= b.right && b.left <= a.right && a.top <= b.bottom &&
+         b.top <= a.bottom;
+}
+
+// Every box overlapping the query, in id order.
+std::vector<int> brute_force(const std::vector<Rect>& boxes,
+                             const Rect& query) {
+  std::vector<int> ids;
+  for (int id = 0; id < (int)boxes.size(); ++id) {
+    if (overlap(boxes[id], query)) ids.push_back(id);
+  }
+  return ids;
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 rng(1);
+  SpatialHash hash(kBoxes);
+  std::vector<Rect> boxes, queries;
+  std::vector<SpatialHash::Hit> hits;
+  int found = 0;
+
+  for (int round = 0; round < kRounds; ++round) {
+    // Later rounds hold fewer boxes, so anything left over from an earlier
+    // build would show up.
+    const int count = kBoxes >> (round % 4);
+    boxes.clear();
+    hash.clear();
+    for (int id = 0; id < count; ++id) {
+      boxes.push_back(random_box(rng, SpatialHash::kCellSize));
+      hash.add(id, boxes.back());
+    }
+    hash.build();
+    expect(hash.size() == count, "wrong size", round, -1);
+
+    queries.clear();
+    for (int q = 0; q < kQueries; ++q) {
+      queries.push_back(
+          random_box(rng, kQueryTiles * SpatialHash::kCellSize));
+    }
+
+    hits.clear();
+    hash.query(queries.data(), kQueries, hits);
+    auto hit = hits.begin();
+    for (int q = 0; q < kQueries; ++q) {
+      const std::vector<int> expected = brute_force(boxes, queries[q]);
+      found += expected.size();
+
+      std::vector<int> single;
+      hash.query(queries[q], [&single](int id) { single.push_back(id); });
+      std::sort(single.begin(), single.end());
+      expect(single == expected, "query found different boxes", round, q);
+
+      std::vector<int> batched;
+      for (; hit != hits.end() && hit->query == q; ++hit) {
+        batched.push_back(hit->id);
+      }
+      std::sort(batched.begin(), batched.end());
+      expect(batched == expected, "batch found different boxes", round, q);
+    }
+    expect(hit == hits.end(), "batch hits out of order", round, -1);
+  }
+
+  // Make sure the queries weren't all empty.
+  if (found == 0) {
+    std::printf("no boxes found\n");
+    ++failures;
+  }
+
+  if (failures > 0) std::printf("%d failures\n", failures);
+  return failures > 0;
+}
@@ -1,17 +1,79 @@
 #include "title_screen.h"
 
+#include "assets.h"
 #include "dungeon_screen.h"
+#include "util.h"
 
-TitleScreen::TitleScreen() : backdrop_("title-char.png"), text_("text.png") {}
+namespace {
+// Without threads the dungeon is made when it is asked for instead.
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+constexpr auto kGenerate = std::launch::deferred;
+#else
+constexpr auto kGenerate = std::launch::async;
+#endif
+}  // namespace
+
+TitleScreen::TitleScreen() : TitleScreen(Util::random_seed(), {}) {}
+
+TitleScreen::TitleScreen(unsigned int seed, std::future<Dungeon> dungeon)
+    : backdrop_(Assets::get().backdrop("title-char.png")),
+      text_(Assets::get().text("text.png")),
+      seed_(seed),
+      endless_(false),
+      enemies_(false),
+      save_(),
+      saved_(save_.load(DungeonScreen::kSaveFile)),
+      continue_(false),
+      dungeon_(std::move(dungeon)) {
+  if (!dungeon_.valid()) {
+    dungeon_ = std::async(kGenerate, DungeonScreen::generate, seed_,
+                          Dungeon::Mode::Classic);
+  }
+}
 
 bool TitleScreen::update(const Input& input, Audio&, unsigned int) {
+  if (input.key_pressed(Input::Button::Y)) {
+    enemies_ = !enemies_;
+    return true;
+  }
+  endless_ = input.key_pressed(Input::Button::Select);
+  continue_ = saved_ && input.key_pressed(Input::Button::Start);
   return !input.any_pressed();
 }
 
 void TitleScreen::draw(Graphics& graphics) const {
-  backdrop_.draw(graphics);
-  text_.draw(graphics, "Press any key", graphics.width() / 2,
-             graphics.height() - 32, Text::Alignment::Center);
+  backdrop_->draw(graphics);
+  text_->draw(graphics, "Press any key", graphics.width() / 2,
+              graphics.height() - 32, Text::Alignment::Center);
+  text_->draw(graphics, "Select for endless mode", graphics.width() / 2,
+              graphics.height() - 20, Text::Alignment::Center);
+  text_->draw(graphics, enemies_ ? "Y for enemies: on" : "Y for enemies: off",
+              graphics.width() / 2, graphics.height() - 8,
+              Text::Alignment::Center);
+  if (saved_) {
+    text_->draw(graphics, "Start to continue", graphics.width() / 2,
+                graphics.height() - 44, Text::Alignment::Center);
+  }
 }
 
-Screen* TitleScreen::next_screen() const { return new DungeonScreen(); }
+// Waiting on the classic dungeon to be thrown away would hold up the other
+// kinds of run, so it goes along with them and comes back to the title
+// screen after.
+Screen* TitleScreen::next_screen() const {
+  if (!continue_ && !endless_) {
+    return new DungeonScreen(seed_, dungeon_.get(), enemies_);
+  }
+
+  DungeonScreen* screen;
+  if (continue_) {
+    screen = new DungeonScreen(save_);
+  } else {
+    // Endless dungeons start with only two rooms, so there is nothing to
+    // wait for.
+    screen = new DungeonScreen(
+        seed_, DungeonScreen::generate(seed_, Dungeon::Mode::Endless),
+        enemies_);
+  }
+  screen->pass_on(seed_, std::move(dungeon_));
+  return screen;
+}
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <future>
+#include <memory>
+
 #include "backdrop.h"
+#include "dungeon.h"
+#include "save_game.h"
 #include "screen.h"
 #include "text.h"
 
 class TitleScreen : public Screen {
  public:
   TitleScreen();
+  // Carries on with a classic dungeon an earlier title screen started
+  // making for the seed, or starts one if there is none.
+  TitleScreen(unsigned int seed, std::future<Dungeon> dungeon);
 
   bool update(const Input&, Audio&, unsigned int) override;
   void draw(Graphics&) const override;
@@ -15,6 +23,15 @@ class TitleScreen : public Screen {
   Screen* next_screen() const override;
 
  private:
-  Backdrop backdrop_;
-  Text text_;
+  std::shared_ptr<const Backdrop> backdrop_;
+  std::shared_ptr<const Text> text_;
+  unsigned int seed_;
+  bool endless_;
+  // Whether a new run has enemies, which Y turns on and off.
+  bool enemies_;
+  // The run left off last time, if there is one, which Start carries on.
+  SaveGame save_;
+  bool saved_, continue_;
+  // The dungeon to play next, made while the title is up.
+  mutable std::future<Dungeon> dungeon_;
 };
@@ -0,0 +1,524 @@
+// Microbenchmarks for dungeon generation, collision, enemies and rendering.
+//
+//   mathemagician-benchmarks [-t ms] [-f filter] [seed]...
+//
+// Every benchmark whose name contains the filter is run against each seed
+// (1 to 5 by default) and prints a CSV line to stdout:
+//
+//   benchmark,seed,iterations,ns_per_op,draws,switches,unsorted_switches
+//
+// The last three are the render queue's stats for the last frame drawn, and
+// are left empty by benchmarks that don't draw.
+//
+// Each result is the best of a few runs that last at least the given time,
+// 50ms by default.  Rendering goes through a render queue with no graphics,
+// so it covers everything up to the point where gam would draw.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "config.h"
+#include "dungeon.h"
+#include "dungeon_renderer.h"
+#include "enemies.h"
+#include "player.h"
+#include "render_queue.h"
+#include "spatial_hash.h"
+
+namespace {
+
+constexpr int kDungeonSize = 1024;
+constexpr int kHudHeight = 5 * Config::kTileSize;
+constexpr int kRepeats = 3;
+constexpr int kBoxCount = 1024;
+constexpr double kBoxSize = 12;
+// Enemies of each kind packed into the first room.
+constexpr int kCrowd = 150;
+constexpr unsigned int kFrameTime = 16;
+
+volatile std::uint64_t sink;
+// Set by benchmarks that draw, for printing with their results.
+std::optional<RenderQueue::Stats> frame_stats;
+
+// The view the camera settles on for a room, with its doors lined up where
+// the renderer expects them.
+Dungeon::Position view_of(const Dungeon& dungeon, int room) {
+  const auto o = dungeon.room_origin(room);
+  return {o.x * Config::kTileSize - 24, o.y * Config::kTileSize - 96};
+}
+
+}  // namespace
+
+class DungeonBenchmarks {
+ public:
+  // Runs the operation being measured the given number of times.
+  using Run = std::function<void(long)>;
+
+  struct Benchmark {
+    const char* name;
+    Run (*setup)(const Dungeon&);
+  };
+
+  static const std::vector<Benchmark>& all() {
+    static const std::vector<Benchmark> benchmarks = {
+        {"dungeon_construct", construct},
+        {"dungeon_generate", generate},
+        {"divide", divide},
+        {"place_room_value", place_room_value},
+        {"box_walkable", box_walkable},
+        {"box_walkable_batch", box_walkable_batch},
+        {"spatial_build", spatial_build},
+        {"spatial_query", spatial_query},
+        {"activate_perfect", activate_perfect},
+        {"activate_overload", activate_overload},
+        {"find_tile", find_tile},
+        {"fork", fork},
+        {"fork_activate", fork_activate},
+        {"render_cached", render_cached},
+        {"render_rooms", render_rooms},
+        {"enemies_update", enemies_update},
+        {"enemies_draw", enemies_draw},
+    };
+    return benchmarks;
+  }
+
+ private:
+  using Cells = std::vector<Dungeon::Position>;
+
+  // The cells to activate to fill a room.
+  struct Solve {
+    int room;
+    Cells order;
+  };
+
+  static Run construct(const Dungeon& base) {
+    const unsigned int seed = base.seed();
+    return [seed](long n) {
+      for (long i = 0; i < n; ++i) {
+        const Dungeon dungeon(kDungeonSize, kDungeonSize, seed);
+        sink = dungeon.attempts();
+      }
+    };
+  }
+
+  // Regenerates with the seed that worked, so every run succeeds.
+  static Run generate(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    return [dungeon](long n) {
+      for (long i = 0; i < n; ++i) sink = dungeon->generate(dungeon->seed());
+    };
+  }
+
+  static Run divide(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    return [dungeon](long n) {
+      std::uint64_t parts = 0;
+      for (long i = 0; i < n; ++i) {
+        const int room = 1 + i % (Dungeon::kRoomCount - 1);
+        parts += dungeon->divide(dungeon->rooms_[room].target, 4).size();
+      }
+      sink = parts;
+    };
+  }
+
+  // Each value placed is taken out again so the room never fills up.
+  static Run place_room_value(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    return [dungeon](long n) {
+      for (long i = 0; i < n; ++i) {
+        const auto o = dungeon->room_origin(1 + i % (Dungeon::kRoomCount - 1));
+        const auto p = dungeon->place_room_value(o.x, o.y, 1);
+        auto& b = dungeon->block(p.x, p.y);
+        b.values[b.index(p.x, p.y)] = 0;
+      }
+    };
+  }
+
+  using Boxes = std::vector<Dungeon::Box>;
+
+  static Run box_walkable(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    auto boxes = scatter_boxes(base);
+    return [dungeon, boxes](long n) {
+      std::uint64_t walkable = 0;
+      for (long i = 0; i < n; ++i) {
+        walkable += dungeon->box_walkable((*boxes)[i % kBoxCount]);
+      }
+      sink = walkable;
+    };
+  }
+
+  // Tests the boxes all together, so each op is one box.
+  static Run box_walkable_batch(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    auto boxes = scatter_boxes(base);
+    auto walkable = std::make_shared<std::array<bool, kBoxCount>>();
+    return [dungeon, boxes, walkable](long n) {
+      std::uint64_t count = 0;
+      for (long i = 0; i < n; i += kBoxCount) {
+        const int batch = static_cast<int>(std::min<long>(kBoxCount, n - i));
+        dungeon->box_walkable(boxes->data(), batch, walkable->data());
+        count += std::count(walkable->begin(), walkable->begin() + batch, true);
+      }
+      sink = count;
+    };
+  }
+
+  // Files the boxes away, so each op is one box.
+  static Run spatial_build(const Dungeon& base) {
+    auto boxes = scatter_boxes(base);
+    auto hash = std::make_shared<SpatialHash>(kBoxCount);
+    return [boxes, hash](long n) {
+      for (long i = 0; i < n; i += kBoxCount) {
+        const int batch = static_cast<int>(std::min<long>(kBoxCount, n - i));
+        hash->clear();
+        for (int j = 0; j < batch; ++j) {
+          const auto& b = (*boxes)[j];
+          hash->add(j, {b.left, b.top, b.right, b.bottom});
+        }
+        hash->build();
+      }
+      sink = hash->size();
+    };
+  }
+
+  // Finds every box overlapping each of the boxes, so each op is one box.
+  static Run spatial_query(const Dungeon& base) {
+    auto boxes = scatter_boxes(base);
+    auto hash = std::make_shared<SpatialHash>(kBoxCount);
+    auto rects = std::make_shared<std::vector<Rect>>();
+    for (int j = 0; j < kBoxCount; ++j) {
+      const auto& b = (*boxes)[j];
+      hash->add(j, {b.left, b.top, b.right, b.bottom});
+      rects->push_back({b.left, b.top, b.right, b.bottom});
+    }
+    hash->build();
+
+    auto hits = std::make_shared<std::vector<SpatialHash::Hit>>();
+    return [hash, rects, hits](long n) {
+      std::uint64_t count = 0;
+      for (long i = 0; i < n; i += kBoxCount) {
+        const int batch = static_cast<int>(std::min<long>(kBoxCount, n - i));
+        hits->clear();
+        hash->query(rects->data(), batch, *hits);
+        count += hits->size();
+      }
+      sink = count;
+    };
+  }
+
+  // Player sized boxes scattered over every room and its walls, a room at a
+  // time as entities would be.
+  static std::shared_ptr<Boxes> scatter_boxes(const Dungeon& base) {
+    auto boxes = std::make_shared<Boxes>();
+    std::mt19937 rng(base.seed());
+    std::uniform_real_distribution<double> dx(0, 13 * Config::kTileSize);
+    std::uniform_real_distribution<double> dy(0, 9 * Config::kTileSize);
+    for (int i = 0; i < kBoxCount; ++i) {
+      const int room = i * Dungeon::kRoomCount / kBoxCount;
+      const auto o = base.room_origin(room);
+      const double x = o.x * Config::kTileSize + dx(rng);
+      const double y = o.y * Config::kTileSize + dy(rng);
+      boxes->push_back({x, y, x + kBoxSize, y + kBoxSize});
+    }
+    return boxes;
+  }
+
+  // Activates just the cells that reach each target exactly.
+  static Run activate_perfect(const Dungeon& base) {
+    return activate(base, Dungeon::Result::Perfect);
+  }
+
+  // Activates cells until the last one goes past each target.
+  static Run activate_overload(const Dungeon& base) {
+    return activate(base, Dungeon::Result::Overload);
+  }
+
+  // A full scan, since nothing is ever out of bounds.
+  static Run find_tile(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    return [dungeon](long n) {
+      for (long i = 0; i < n; ++i) {
+        sink = dungeon->find_tile(Dungeon::Tile::OutOfBounds).x;
+      }
+    };
+  }
+
+  // What a search agent does to branch: copy the dungeon and the player.
+  static Run fork(const Dungeon& base) {
+    auto dungeon = std::make_shared<const Dungeon>(base);
+    auto player = std::make_shared<const Player>(0, 0);
+    return [dungeon, player](long n) {
+      for (long i = 0; i < n; ++i) {
+        const Dungeon d = *dungeon;
+        const Player p = *player;
+        sink = d.revision() + p.health();
+      }
+    };
+  }
+
+  // A branch that changes something, so a block has to be copied.
+  static Run fork_activate(const Dungeon& base) {
+    auto dungeon = std::make_shared<const Dungeon>(base);
+    auto cells = std::make_shared<Cells>(base.value_cells(1));
+    return [dungeon, cells](long n) {
+      for (long i = 0; i < n; ++i) {
+        Dungeon d = *dungeon;
+        const auto& p = (*cells)[i % cells->size()];
+        sink = (int)d.activate(p.x, p.y);
+      }
+    };
+  }
+
+  // A camera standing still in the first room.
+  static Run render_cached(const Dungeon& base) {
+    return render(base, false);
+  }
+
+  // A camera moving to a different room every frame.
+  static Run render_rooms(const Dungeon& base) { return render(base, true); }
+
+  // A room full of enemies going about their business, with the player
+  // watching from the entrance.
+  static Run enemies_update(const Dungeon& base) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    auto enemies = crowd(base);
+    const auto o = base.room_origin(0);
+    auto player = std::make_shared<Player>((o.x + 6) * Config::kTileSize,
+                                           (o.y + 4) * Config::kTileSize);
+    return [dungeon, enemies, player](long n) {
+      for (long i = 0; i < n; ++i) {
+        enemies->update(*dungeon, *player, kFrameTime);
+      }
+      sink = enemies->count();
+    };
+  }
+
+  static Run enemies_draw(const Dungeon& base) {
+    auto enemies = crowd(base);
+    auto queue = std::make_shared<RenderQueue>();
+    const auto view = view_of(base, 1);
+
+    return [enemies, queue, view](long n) {
+      for (long i = 0; i < n; ++i) {
+        queue->begin(kConfig.graphics.width, kConfig.graphics.height);
+        enemies->draw(*queue, view.x, view.y);
+        queue->flush();
+      }
+      sink = queue->stats().draws;
+      frame_stats = queue->stats();
+    };
+  }
+
+  static std::shared_ptr<Enemies> crowd(const Dungeon& base) {
+    auto enemies = std::make_shared<Enemies>(base.seed());
+    std::mt19937 rng(base.seed());
+    std::uniform_int_distribution<int> cx(1, 11), cy(1, 7);
+    const auto o = base.room_origin(1);
+    for (int k = 0; k < Enemies::kKindCount; ++k) {
+      for (int i = 0; i < kCrowd;) {
+        const int x = o.x + cx(rng), y = o.y + cy(rng);
+        if (!base.walkable(x, y)) continue;
+        enemies->spawn(static_cast<Enemies::Kind>(k),
+                       (x + 0.5) * Config::kTileSize,
+                       (y + 0.5) * Config::kTileSize);
+        ++i;
+      }
+    }
+    return enemies;
+  }
+
+  static Run activate(const Dungeon& base, Dungeon::Result result) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    auto original = std::make_shared<const Dungeon>(base);
+    auto solves = std::make_shared<std::vector<Solve>>();
+    for (int room = 1; room < Dungeon::kRoomCount; ++room) {
+      Cells order;
+      if (solve(base, room, result, order)) solves->push_back({room, order});
+    }
+
+    return [dungeon, original, solves](long n) {
+      if (solves->empty()) return;
+      for (long i = 0; i < n; ++i) {
+        const Solve& s = (*solves)[i % solves->size()];
+        for (const auto& p : s.order) sink = (int)dungeon->activate(p.x, p.y);
+        // Put back the values that were cleared.
+        for (const auto& p : dungeon->value_cells(s.room)) {
+          auto& b = dungeon->block(p.x, p.y);
+          const int j = b.index(p.x, p.y);
+          b.values[j] = original->get_cell(p.x, p.y).value;
+          b.active[j] = false;
+        }
+      }
+    };
+  }
+
+  // Finds an order to activate the cells of a room in that ends with the
+  // given result, or returns false if there is none.
+  static bool solve(const Dungeon& dungeon, int room, Dungeon::Result result,
+                    Cells& order) {
+    const int target = dungeon.room(room).target;
+    Cells cells = dungeon.value_cells(room);
+    auto value = [&dungeon](const Dungeon::Position& p) {
+      return dungeon.get_cell(p.x, p.y).value;
+    };
+    order.clear();
+
+    if (result == Dungeon::Result::Perfect) {
+      // The cell that first reached each total, walked back from the
+      // target.  Every total below the target is short of done.
+      std::vector<int> from(target + 1, -1);
+      from[0] = cells.size();
+      for (size_t i = 0; i < cells.size(); ++i) {
+        const int v = value(cells[i]);
+        for (int t = target; t >= v; --t) {
+          if (from[t] < 0 && from[t - v] >= 0) from[t] = i;
+        }
+      }
+      if (from[target] < 0) return false;
+      for (int t = target; t > 0; t -= value(cells[from[t]])) {
+        order.push_back(cells[from[t]]);
+      }
+      return true;
+    }
+
+    // Take the largest values that stay under the target, then one that
+    // goes past it.
+    std::sort(cells.begin(), cells.end(),
+              [&value](const Dungeon::Position& a, const Dungeon::Position& b) {
+                return value(a) > value(b);
+              });
+    int total = 0;
+    Cells rest;
+    for (const auto& p : cells) {
+      if (total + value(p) < target) {
+        total += value(p);
+        order.push_back(p);
+      } else {
+        rest.push_back(p);
+      }
+    }
+    for (const auto& p : rest) {
+      if (total + value(p) > target) {
+        order.push_back(p);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static Run render(const Dungeon& base, bool moving) {
+    auto dungeon = std::make_shared<Dungeon>(base);
+    auto renderer = std::make_shared<DungeonRenderer>();
+    auto queue = std::make_shared<RenderQueue>();
+
+    return [dungeon, renderer, queue, moving](long n) {
+      for (long i = 0; i < n; ++i) {
+        const int room = moving ? i % Dungeon::kRoomCount : 0;
+        const auto view = view_of(*dungeon, room);
+        queue->begin(kConfig.graphics.width, kConfig.graphics.height);
+        renderer->draw(*queue, *dungeon, kHudHeight, view.x, view.y);
+        queue->flush();
+      }
+      sink = queue->stats().draws;
+      frame_stats = queue->stats();
+    };
+  }
+};
+
+namespace {
+
+double seconds(const DungeonBenchmarks::Run& run, long n) {
+  const auto start = std::chrono::steady_clock::now();
+  run(n);
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Works out how many iterations fill the minimum time, then keeps the
+// fastest of a few runs of that many.
+double measure(const DungeonBenchmarks::Run& run, double min_time,
+               long& iterations) {
+  long n = 1;
+  double elapsed = seconds(run, n);
+  while (elapsed < min_time) {
+    const double scale = elapsed > 0 ? 1.2 * min_time / elapsed : 10;
+    n = std::max(n + 1, static_cast<long>(n * std::min(scale, 10.0)));
+    elapsed = seconds(run, n);
+  }
+
+  double best = elapsed;
+  for (int i = 1; i < kRepeats; ++i) best = std::min(best, seconds(run, n));
+  iterations = n;
+  return best * 1e9 / n;
+}
+
+int usage(const char* name) {
+  std::fprintf(stderr, "usage: %s [-t ms] [-f filter] [seed]...\n", name);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double min_time = 0.05;
+  std::string filter;
+  int arg = 1;
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (std::strcmp(argv[arg], "-t") == 0) {
+      min_time = std::max(1, std::atoi(argv[arg + 1])) / 1000.0;
+    } else if (std::strcmp(argv[arg], "-f") == 0) {
+      filter = argv[arg + 1];
+    } else {
+      return usage(argv[0]);
+    }
+    arg += 2;
+  }
+
+  std::vector<unsigned int> seeds;
+  for (; arg < argc; ++arg) {
+    if (argv[arg][0] == '-') return usage(argv[0]);
+    seeds.push_back(std::strtoul(argv[arg], nullptr, 10));
+  }
+  if (seeds.empty()) seeds = {1, 2, 3, 4, 5};
+
+  std::vector<Dungeon> dungeons;
+  for (unsigned int seed : seeds) {
+    dungeons.emplace_back(kDungeonSize, kDungeonSize, seed);
+  }
+
+  std::printf(
+      "benchmark,seed,iterations,ns_per_op,draws,switches,"
+      "unsorted_switches\n");
+  for (const auto& b : DungeonBenchmarks::all()) {
+    if (std::strstr(b.name, filter.c_str()) == nullptr) continue;
+    for (size_t i = 0; i < seeds.size(); ++i) {
+      const auto run = b.setup(dungeons[i]);
+      long iterations = 0;
+      frame_stats.reset();
+      const double ns = measure(run, min_time, iterations);
+      std::printf("%s,%u,%ld,%.1f,", b.name, seeds[i], iterations, ns);
+      if (frame_stats) {
+        std::printf("%d,%d,%d\n", frame_stats->draws, frame_stats->switches,
+                    frame_stats->unsorted_switches);
+      } else {
+        std::printf(",,\n");
+      }
+      std::fflush(stdout);
+    }
+  }
+
+  return 0;
+}
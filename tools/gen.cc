@@ -0,0 +1,204 @@
+// Generates dungeons for a range of seeds and dumps their layouts without
+// touching any graphics or audio.
+//
+//   mathemagician-gen [--binary] first [last]
+//
+// By default each dungeon is written to stdout as one line of JSON, where
+// each room past the entrance also has the number of ways its target can be
+// hit and the value cells of a way that takes the fewest.  With --binary,
+// dungeons are written as a compact record stream instead:
+//
+//   "MGEN" u8 version
+//   per dungeon:
+//     u32 seed, u32 generated seed, u8 room count
+//     per room:
+//       i16 x, i16 y, u16 target, 59 bytes of tiles (13x9, two per byte)
+//       u8 value count, per value: u8 x, u8 y, u8 value (relative to room)
+//     u8 door count, per door: i16 x, i16 y, i8 from, i8 to
+//
+// All multi-byte integers are little endian.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "dungeon.h"
+
+namespace {
+
+constexpr int kRoomWidth = 13;
+constexpr int kRoomHeight = 9;
+constexpr std::uint8_t kBinaryVersion = 1;
+
+char tile_char(Dungeon::Tile tile) {
+  switch (tile) {
+    case Dungeon::Tile::OutOfBounds:
+      return ' ';
+    case Dungeon::Tile::Wall:
+      return '#';
+    case Dungeon::Tile::Room:
+      return '.';
+    case Dungeon::Tile::Block:
+      return 'x';
+    case Dungeon::Tile::DoorLocked:
+      return 'L';
+    case Dungeon::Tile::DoorClosed:
+      return 'C';
+    case Dungeon::Tile::DoorOpen:
+      return 'O';
+    case Dungeon::Tile::Pit:
+      return 'o';
+    case Dungeon::Tile::Sand:
+      return 's';
+    case Dungeon::Tile::StatueLeft:
+      return 'l';
+    case Dungeon::Tile::StatueRight:
+      return 'r';
+  }
+  return '?';
+}
+
+void put_u8(std::uint8_t v) { std::fputc(v, stdout); }
+
+void put_u16(std::uint16_t v) {
+  put_u8(v & 0xff);
+  put_u8(v >> 8);
+}
+
+void put_u32(std::uint32_t v) {
+  put_u16(v & 0xffff);
+  put_u16(v >> 16);
+}
+
+void dump_binary(unsigned int seed, const Dungeon& dungeon) {
+  put_u32(seed);
+  put_u32(dungeon.seed());
+  put_u8(Dungeon::kRoomCount);
+
+  for (int n = 0; n < Dungeon::kRoomCount; ++n) {
+    const auto origin = dungeon.room_origin(n);
+    put_u16(static_cast<std::int16_t>(origin.x));
+    put_u16(static_cast<std::int16_t>(origin.y));
+    put_u16(dungeon.room(n).target);
+
+    std::uint8_t packed = 0;
+    for (int i = 0; i < kRoomWidth * kRoomHeight; ++i) {
+      const auto cell = dungeon.get_cell(origin.x + i % kRoomWidth,
+                                         origin.y + i / kRoomWidth);
+      const auto tile = static_cast<std::uint8_t>(cell.tile);
+      if (i % 2 == 0) {
+        packed = tile;
+      } else {
+        put_u8(packed | tile << 4);
+      }
+    }
+    put_u8(packed);
+
+    const auto& values = dungeon.value_cells(n);
+    put_u8(values.size());
+    for (const auto& p : values) {
+      put_u8(p.x - origin.x);
+      put_u8(p.y - origin.y);
+      put_u8(dungeon.get_cell(p.x, p.y).value);
+    }
+  }
+
+  put_u8(dungeon.doors().size());
+  for (const auto& door : dungeon.doors()) {
+    put_u16(static_cast<std::int16_t>(door.position.x));
+    put_u16(static_cast<std::int16_t>(door.position.y));
+    put_u8(static_cast<std::int8_t>(door.from));
+    put_u8(static_cast<std::int8_t>(door.to));
+  }
+}
+
+void dump_json(unsigned int seed, const Dungeon& dungeon) {
+  std::printf("{\"seed\":%u,\"generated_seed\":%u,\"rooms\":[", seed,
+              dungeon.seed());
+
+  for (int n = 0; n < Dungeon::kRoomCount; ++n) {
+    const auto origin = dungeon.room_origin(n);
+    std::printf("%s{\"number\":%d,\"x\":%d,\"y\":%d,\"target\":%d,\"tiles\":[",
+                n > 0 ? "," : "", n, origin.x, origin.y,
+                dungeon.room(n).target);
+
+    for (int y = 0; y < kRoomHeight; ++y) {
+      std::string row;
+      for (int x = 0; x < kRoomWidth; ++x) {
+        row += tile_char(dungeon.get_cell(origin.x + x, origin.y + y).tile);
+      }
+      std::printf("%s\"%s\"", y > 0 ? "," : "", row.c_str());
+    }
+
+    std::printf("],\"values\":[");
+    const auto& values = dungeon.value_cells(n);
+    for (size_t i = 0; i < values.size(); ++i) {
+      const auto& p = values[i];
+      std::printf("%s[%d,%d,%d]", i > 0 ? "," : "", p.x, p.y,
+                  dungeon.get_cell(p.x, p.y).value);
+    }
+    std::printf("]");
+
+    // The entrance has nothing to solve.
+    if (dungeon.room(n)) {
+      const auto solution = dungeon.solution(n);
+      std::printf(",\"solutions\":%llu,\"minimum\":[",
+                  static_cast<unsigned long long>(solution.count));
+      for (size_t i = 0; i < solution.minimum.size(); ++i) {
+        const auto& p = values[solution.minimum[i]];
+        std::printf("%s[%d,%d]", i > 0 ? "," : "", p.x, p.y);
+      }
+      std::printf("]");
+    }
+    std::printf("}");
+  }
+
+  std::printf("],\"doors\":[");
+  const auto& doors = dungeon.doors();
+  for (size_t i = 0; i < doors.size(); ++i) {
+    const auto& door = doors[i];
+    std::printf("%s[%d,%d,%d,%d]", i > 0 ? "," : "", door.position.x,
+                door.position.y, door.from, door.to);
+  }
+  std::printf("]}\n");
+}
+
+int usage(const char* name) {
+  std::fprintf(stderr, "usage: %s [--binary] first [last]\n", name);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool binary = false;
+  int arg = 1;
+  if (arg < argc && std::strcmp(argv[arg], "--binary") == 0) {
+    binary = true;
+    ++arg;
+  }
+
+  if (arg >= argc) return usage(argv[0]);
+  const unsigned long first = std::strtoul(argv[arg++], nullptr, 10);
+  const unsigned long last =
+      arg < argc ? std::strtoul(argv[arg++], nullptr, 10) : first;
+  if (arg < argc || last < first) return usage(argv[0]);
+
+  if (binary) {
+    std::fwrite("MGEN", 1, 4, stdout);
+    put_u8(kBinaryVersion);
+  }
+
+  for (unsigned long seed = first; seed <= last; ++seed) {
+    const Dungeon dungeon(1024, 1024, seed);
+    if (binary) {
+      dump_binary(seed, dungeon);
+    } else {
+      dump_json(seed, dungeon);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,92 @@
+#include "predicates.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace {
+
+// Length of the longest chain of rooms placed in the same direction.
+int longest_straight_run(const Dungeon& dungeon) {
+  int longest = 1, run = 1;
+  int dx = 0, dy = 0;
+  for (int n = 1; n < Dungeon::kRoomCount; ++n) {
+    const auto a = dungeon.room_origin(n - 1);
+    const auto b = dungeon.room_origin(n);
+    if (b.x - a.x == dx && b.y - a.y == dy) {
+      ++run;
+    } else {
+      dx = b.x - a.x;
+      dy = b.y - a.y;
+      run = 2;
+    }
+    longest = std::max(longest, run);
+  }
+  return longest;
+}
+
+bool straight(const Dungeon& dungeon, int arg) {
+  return longest_straight_run(dungeon) >= arg;
+}
+
+bool final_target(const Dungeon& dungeon, int arg) {
+  return dungeon.room(Dungeon::kRoomCount - 1).target >= arg;
+}
+
+bool uses_template(const Dungeon& dungeon, int arg) {
+  for (int n = 1; n < Dungeon::kRoomCount; ++n) {
+    if (dungeon.room_template(n) == arg) return true;
+  }
+  return false;
+}
+
+bool few_solutions(const Dungeon& dungeon, int arg) {
+  for (int n = 1; n < Dungeon::kRoomCount; ++n) {
+    if (!dungeon.room(n)) continue;
+    const auto count = dungeon.solution(n).count;
+    if (count > 0 && count <= static_cast<std::uint64_t>(arg)) return true;
+  }
+  return false;
+}
+
+bool unsolvable(const Dungeon& dungeon, int) {
+  for (int n = 1; n < Dungeon::kRoomCount; ++n) {
+    if (!dungeon.solvable(n)) return true;
+  }
+  return false;
+}
+
+bool retried(const Dungeon& dungeon, int arg) {
+  return dungeon.attempts() > std::max(arg, 1);
+}
+
+}  // namespace
+
+const std::vector<Predicate>& predicates() {
+  static const std::vector<Predicate> table = {
+      {"straight", "at least N rooms in a straight line", straight},
+      {"final-target", "last room has a target of at least N", final_target},
+      {"template", "some room uses room template N", uses_template},
+      {"solutions", "some room has at most N ways to hit its target",
+       few_solutions},
+      {"unsolvable", "some room can't hit its target", unsolvable},
+      {"retried", "generation took more than N attempts (default 1)",
+       retried},
+  };
+  return table;
+}
+
+bool parse_condition(const std::string& spec, Condition& condition) {
+  const auto eq = spec.find('=');
+  const std::string name = spec.substr(0, eq);
+  const int arg =
+      eq == std::string::npos ? 0 : std::atoi(spec.c_str() + eq + 1);
+
+  for (const auto& p : predicates()) {
+    if (name == p.name) {
+      condition = {&p, arg};
+      return true;
+    }
+  }
+  return false;
+}
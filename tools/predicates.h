@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dungeon.h"
+
+// Layout predicates for the seed search.  To add one, append an entry to the
+// table in predicates.cc; it becomes available on the command line by name.
+struct Predicate {
+  const char* name;
+  const char* help;
+  bool (*test)(const Dungeon& dungeon, int arg);
+};
+
+// A predicate together with the argument it was given on the command line.
+struct Condition {
+  const Predicate* predicate;
+  int arg;
+
+  bool operator()(const Dungeon& dungeon) const {
+    return predicate->test(dungeon, arg);
+  }
+};
+
+const std::vector<Predicate>& predicates();
+
+// Parses "name" or "name=arg".  Returns false for unknown predicates.
+bool parse_condition(const std::string& spec, Condition& condition);
@@ -0,0 +1,70 @@
+// Plays back a recorded run without rendering and checks that it ends the
+// way it should.
+//
+//   mathemagician-replay [--checksums] file
+//
+// With --checksums a hash of the game state is printed after every tick, so
+// the output of two builds can be diffed to find where they desync.  How
+// much faster than realtime the playback ran is reported on stderr.
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "replay.h"
+#include "sim.h"
+
+namespace {
+
+int usage(const char* name) {
+  std::fprintf(stderr, "usage: %s [--checksums] file\n", name);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool checksums = false;
+  int arg = 1;
+  if (arg < argc && std::strcmp(argv[arg], "--checksums") == 0) {
+    checksums = true;
+    ++arg;
+  }
+  if (arg + 1 != argc) return usage(argv[0]);
+
+  Replay replay;
+  if (!replay.load(argv[arg])) {
+    std::fprintf(stderr, "unable to load replay %s\n", argv[arg]);
+    return 1;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  Sim sim(replay.seed(), replay.mode(), replay.enemies());
+  unsigned long tick = 0, game_time = 0;
+  for (const auto& run : replay.runs()) {
+    for (std::uint32_t i = 0; i < run.ticks; ++i) {
+      sim.step(run.buttons, run.elapsed);
+      if (checksums) {
+        std::printf("%lu %016" PRIx64 "\n", tick, sim.checksum());
+      }
+      ++tick;
+    }
+    game_time += (unsigned long)run.ticks * run.elapsed;
+  }
+  const double elapsed = std::chrono::duration<double>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+
+  const auto& o = sim.observation();
+  std::fprintf(stderr, "seed %u%s%s: %lu ticks in %zu runs, %.1fs of play\n",
+               replay.seed(),
+               replay.mode() == Dungeon::Mode::Endless ? " endless" : "",
+               replay.enemies() ? " with enemies" : "", tick,
+               replay.runs().size(), game_time / 1000.0);
+  std::fprintf(stderr, "final: %d hp, %d orbs, %s, checksum %016" PRIx64 "\n",
+               o.health, o.orbs, o.done ? "dead" : "alive", sim.checksum());
+  std::fprintf(stderr, "played back in %.3fs, %.0fx realtime\n", elapsed,
+               game_time / 1000.0 / elapsed);
+  return 0;
+}
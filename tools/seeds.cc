@@ -0,0 +1,181 @@
+// Searches a range of seeds in parallel for dungeons that match every given
+// layout predicate.
+//
+//   mathemagician-seeds [-c] [-j threads] first last predicate[=N]...
+//
+// With -c dungeons are checked as they are made, so rooms that can't be
+// solved are made again.  Matching seeds are printed to stdout in
+// increasing order.  Throughput,
+// generation latency and how often generation had to retry with a bumped
+// seed are reported on stderr.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "dungeon.h"
+#include "predicates.h"
+
+namespace {
+
+constexpr unsigned long kChunkSize = 64;
+
+// Each worker starts with its own slice of the seed range and claims chunks
+// from it.  Once its slice is exhausted it steals chunks from the others.
+struct Slice {
+  std::atomic<unsigned long> next;
+  unsigned long end;
+};
+
+struct Stats {
+  std::vector<unsigned long> matches;
+  std::vector<std::uint32_t> latencies;
+  unsigned long retried = 0;
+  unsigned long extra_attempts = 0;
+};
+
+bool claim(Slice& slice, unsigned long& begin, unsigned long& end) {
+  if (slice.next.load(std::memory_order_relaxed) >= slice.end) return false;
+  begin = slice.next.fetch_add(kChunkSize, std::memory_order_relaxed);
+  if (begin >= slice.end) return false;
+  end = std::min(begin + kChunkSize, slice.end);
+  return true;
+}
+
+void search(std::vector<Slice>& slices, size_t self, bool checked,
+            const std::vector<Condition>& conditions, Stats& stats) {
+  unsigned long begin, end;
+  size_t victim = self;
+
+  while (true) {
+    if (!claim(slices[victim], begin, end)) {
+      victim = (victim + 1) % slices.size();
+      if (victim == self) return;
+      continue;
+    }
+
+    for (unsigned long seed = begin; seed < end; ++seed) {
+      const auto start = std::chrono::steady_clock::now();
+      const Dungeon dungeon(1024, 1024, seed, Dungeon::Mode::Classic,
+                            checked);
+      const auto elapsed = std::chrono::steady_clock::now() - start;
+
+      stats.latencies.push_back(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+              .count());
+      if (dungeon.attempts() > 1) {
+        ++stats.retried;
+        stats.extra_attempts += dungeon.attempts() - 1;
+      }
+
+      const bool match =
+          std::all_of(conditions.begin(), conditions.end(),
+                      [&dungeon](const Condition& c) { return c(dungeon); });
+      if (match) stats.matches.push_back(seed);
+    }
+  }
+}
+
+double percentile(const std::vector<std::uint32_t>& sorted, double p) {
+  if (sorted.empty()) return 0;
+  const size_t i = std::min(sorted.size() - 1, (size_t)(p * sorted.size()));
+  return sorted[i] / 1000.0;
+}
+
+int usage(const char* name) {
+  std::fprintf(stderr,
+               "usage: %s [-c] [-j threads] first last predicate[=N]...\n",
+               name);
+  std::fprintf(stderr, "\npredicates:\n");
+  for (const auto& p : predicates()) {
+    std::fprintf(stderr, "  %-14s %s\n", p.name, p.help);
+  }
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+  bool checked = false;
+  int arg = 1;
+  if (arg < argc && std::strcmp(argv[arg], "-c") == 0) {
+    checked = true;
+    ++arg;
+  }
+  if (arg + 1 < argc && std::strcmp(argv[arg], "-j") == 0) {
+    threads = std::max(1, std::atoi(argv[arg + 1]));
+    arg += 2;
+  }
+
+  if (argc - arg < 2) return usage(argv[0]);
+  const unsigned long first = std::strtoul(argv[arg++], nullptr, 10);
+  const unsigned long last = std::strtoul(argv[arg++], nullptr, 10);
+  if (last < first) return usage(argv[0]);
+
+  std::vector<Condition> conditions;
+  for (; arg < argc; ++arg) {
+    Condition c;
+    if (!parse_condition(argv[arg], c)) {
+      std::fprintf(stderr, "unknown predicate %s\n", argv[arg]);
+      return usage(argv[0]);
+    }
+    conditions.push_back(c);
+  }
+
+  const unsigned long count = last - first + 1;
+  threads = std::min<unsigned long>(threads, count);
+
+  std::vector<Slice> slices(threads);
+  for (unsigned int i = 0; i < threads; ++i) {
+    slices[i].next = first + count * i / threads;
+    slices[i].end = first + count * (i + 1) / threads;
+  }
+
+  std::vector<Stats> stats(threads);
+  std::vector<std::thread> workers;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < threads; ++i) {
+    workers.emplace_back(search, std::ref(slices), i, checked,
+                         std::cref(conditions), std::ref(stats[i]));
+  }
+  for (auto& w : workers) w.join();
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+
+  Stats total;
+  for (const auto& s : stats) {
+    total.matches.insert(total.matches.end(), s.matches.begin(),
+                         s.matches.end());
+    total.latencies.insert(total.latencies.end(), s.latencies.begin(),
+                           s.latencies.end());
+    total.retried += s.retried;
+    total.extra_attempts += s.extra_attempts;
+  }
+  std::sort(total.matches.begin(), total.matches.end());
+  std::sort(total.latencies.begin(), total.latencies.end());
+
+  for (auto seed : total.matches) std::printf("%lu\n", seed);
+
+  std::fprintf(stderr, "%lu seeds in %.3fs on %u threads: %.0f seeds/s\n",
+               count, elapsed.count(), threads, count / elapsed.count());
+  std::fprintf(stderr,
+               "generation: p50 %.1fus  p90 %.1fus  p99 %.1fus  max %.1fus\n",
+               percentile(total.latencies, 0.5),
+               percentile(total.latencies, 0.9),
+               percentile(total.latencies, 0.99),
+               percentile(total.latencies, 1.0));
+  std::fprintf(stderr, "retried: %lu seeds (%.2f%%), %lu extra attempts\n",
+               total.retried, 100.0 * total.retried / count,
+               total.extra_attempts);
+  std::fprintf(stderr, "matched: %zu seeds\n", total.matches.size());
+
+  return 0;
+}
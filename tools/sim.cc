@@ -0,0 +1,130 @@
+// Plays a batch of headless games with a random agent and reports how fast
+// they can be stepped.
+//
+//   mathemagician-sim [-e] [-m] [-n games] [-t ticks] [first_seed]
+//
+// With -e the games are played in endless dungeons, and with -m rooms are
+// filled with enemies.
+//
+// Each game holds a random direction for a while and now and then tries to
+// interact or focus.  Games that finish are restarted with the next unused
+// seed.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "sim.h"
+
+namespace {
+
+const unsigned int kDirections[] = {Player::kLeft, Player::kRight,
+                                    Player::kUp, Player::kDown, 0};
+
+struct Agent {
+  std::uint32_t state;
+  unsigned int held;
+
+  std::uint32_t next() {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  unsigned int buttons() {
+    const std::uint32_t r = next();
+    if (r % 16 == 0) held = kDirections[(r >> 4) % 5];
+    unsigned int b = held;
+    if ((r >> 8) % 64 == 0) b |= Player::kInteract;
+    if ((r >> 14) % 128 == 0) b |= Player::kFocus;
+    return b;
+  }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+int usage(const char* name) {
+  std::fprintf(stderr,
+               "usage: %s [-e] [-m] [-n games] [-t ticks] [first_seed]\n",
+               name);
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int games = 64;
+  long ticks = 100000;
+  auto mode = Dungeon::Mode::Classic;
+  bool enemies = false;
+  int arg = 1;
+  for (; arg < argc; ++arg) {
+    if (std::strcmp(argv[arg], "-e") == 0) {
+      mode = Dungeon::Mode::Endless;
+    } else if (std::strcmp(argv[arg], "-m") == 0) {
+      enemies = true;
+    } else {
+      break;
+    }
+  }
+  while (arg + 1 < argc && argv[arg][0] == '-') {
+    if (std::strcmp(argv[arg], "-n") == 0) {
+      games = std::max(1, std::atoi(argv[arg + 1]));
+    } else if (std::strcmp(argv[arg], "-t") == 0) {
+      ticks = std::max(1L, std::atol(argv[arg + 1]));
+    } else {
+      return usage(argv[0]);
+    }
+    arg += 2;
+  }
+  unsigned int seed =
+      arg < argc ? std::strtoul(argv[arg++], nullptr, 10) : 0;
+  if (arg < argc) return usage(argv[0]);
+
+  auto start = std::chrono::steady_clock::now();
+  SimBatch batch(seed, games, mode, enemies);
+  seed += games;
+  const double setup = seconds_since(start);
+
+  std::vector<Agent> agents(games);
+  for (int i = 0; i < games; ++i) agents[i] = {0x9e3779b9u * (i + 1), 0};
+  std::vector<unsigned int> buttons(games);
+
+  long resets = 0, orbs = 0, overloads = 0;
+  double reset_time = 0;
+  start = std::chrono::steady_clock::now();
+  for (long t = 0; t < ticks; ++t) {
+    for (int i = 0; i < games; ++i) buttons[i] = agents[i].buttons();
+    batch.step(buttons.data());
+
+    for (int i = 0; i < games; ++i) {
+      const auto& o = batch[i].observation();
+      if (o.events & 1u << static_cast<int>(Player::Sound::Orb)) ++orbs;
+      if (o.result == Dungeon::Result::Overload) ++overloads;
+      if (o.done) {
+        const auto reset_start = std::chrono::steady_clock::now();
+        batch[i].reset(seed++);
+        reset_time += seconds_since(reset_start);
+        ++resets;
+      }
+    }
+  }
+  const double elapsed = seconds_since(start) - reset_time;
+
+  const double steps = (double)ticks * games;
+  std::fprintf(stderr, "%d games set up in %.3fs\n", games, setup);
+  std::fprintf(stderr, "%.0f steps in %.3fs: %.0f steps/s\n", steps, elapsed,
+               steps / elapsed);
+  std::fprintf(stderr, "%ld orbs, %ld overloads, %ld games restarted\n", orbs,
+               overloads, resets);
+  return 0;
+}
@@ -2,25 +2,44 @@
 
 #include "config.h"
 
-void UI::draw_small_number(Graphics& graphics, const SpriteMap& sprites, int x,
+void UI::draw_small_number(RenderQueue& queue, const SpriteMap& sprites, int x,
                            int y, int number, Color color) {
-  draw_digit_string(graphics, sprites, x, y, number, base_for_color(color));
+  draw_digit_string(queue, sprites, x, y, number, base_for_color(color));
 }
 
-void UI::draw_large_number(Graphics& graphics, const SpriteMap& sprites, int x,
+void UI::draw_large_number(RenderQueue& queue, const SpriteMap& sprites, int x,
                            int y, int number) {
-  draw_digit_string(graphics, sprites, x, y, number, 0);
-  draw_digit_string(graphics, sprites, x, y + Config::kHalfTile, number, 10);
+  draw_digit_string(queue, sprites, x, y, number, 0);
+  draw_digit_string(queue, sprites, x, y + Config::kHalfTile, number, 10);
 }
 
-void UI::draw_digit_string(Graphics& graphics, const SpriteMap& sprites, int x,
+int UI::layout_small_number(int x, int y, int number, Color color,
+                            Glyph* glyphs) {
+  return layout_digits(x, y, number, base_for_color(color), glyphs);
+}
+
+void UI::draw_digit_string(RenderQueue& queue, const SpriteMap& sprites, int x,
                            int y, int number, int base) {
-  const std::string digits = std::to_string(number);
-  int dx = x + 1;
-  for (const char& c : digits) {
-    sprites.draw(graphics, base + c - '0', dx, y);
-    dx += Config::kHalfTile - 1;
+  Glyph glyphs[kMaxDigits];
+  const int count = layout_digits(x, y, number, base, glyphs);
+  for (int i = 0; i < count; ++i) {
+    queue.draw(sprites, glyphs[i].sprite, glyphs[i].x, glyphs[i].y);
+  }
+}
+
+int UI::layout_digits(int x, int y, int number, int base, Glyph* glyphs) {
+  char digits[kMaxDigits];
+  int count = 0;
+  do {
+    digits[count++] = number % 10;
+    number /= 10;
+  } while (number > 0);
+
+  for (int i = 0; i < count; ++i) {
+    glyphs[i] = {base + digits[count - 1 - i],
+                 x + 1 + i * (Config::kHalfTile - 1), y};
   }
+  return count;
 }
 
 int UI::base_for_color(Color color) {
@@ -1,18 +1,31 @@
 #pragma once
 
 #include "graphics.h"
+#include "render_queue.h"
 #include "spritemap.h"
 
 class UI {
  public:
   enum class Color { Black, White, Cyan };
-  static void draw_small_number(Graphics& graphics, const SpriteMap& sprites,
+
+  struct Glyph {
+    int sprite, x, y;
+  };
+  static constexpr int kMaxDigits = 10;
+
+  // Works out where each digit of a small number goes without drawing it.
+  // Returns how many of glyphs were filled in.  Numbers are never negative.
+  static int layout_small_number(int x, int y, int number, Color color,
+                                 Glyph* glyphs);
+  static void draw_small_number(RenderQueue& queue, const SpriteMap& sprites,
                                 int x, int y, int number, Color color);
-  static void draw_large_number(Graphics& graphics, const SpriteMap& sprites,
+  static void draw_large_number(RenderQueue& queue, const SpriteMap& sprites,
                                 int x, int y, int number);
 
  private:
-  static void draw_digit_string(Graphics& graphics, const SpriteMap& sprites,
+  static void draw_digit_string(RenderQueue& queue, const SpriteMap& sprites,
                                 int x, int y, int number, int offset);
+  static int layout_digits(int x, int y, int number, int base,
+                           Glyph* glyphs);
   static int base_for_color(Color color);
 };
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Little-endian base 128, so small values take a byte.
+inline void put_varint(std::string& out, std::uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+inline bool get_varint(const std::string& in, size_t& pos,
+                       std::uint32_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 35 && pos < in.size(); shift += 7) {
+    const auto byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<std::uint32_t>(byte & 0x7f) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+// Doubles are kept exactly, as their bits.
+inline void put_double(std::string& out, double value) {
+  std::uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  for (int i = 0; i < 8; ++i) out.push_back(static_cast<char>(bits >> 8 * i));
+}
+
+inline bool get_double(const std::string& in, size_t& pos, double& value) {
+  if (in.size() - pos < 8) return false;
+  std::uint64_t bits = 0;
+  for (int i = 0; i < 8; ++i) {
+    bits |= std::uint64_t(static_cast<unsigned char>(in[pos++])) << 8 * i;
+  }
+  std::memcpy(&value, &bits, sizeof(value));
+  return true;
+}